@@ -7,6 +7,9 @@
 #define TWO_AM_BUILD_IMPL
 #include "2am-builder.h"
 
+#include <stdio.h>
+#include <string.h>
+
 static void compiler_config(void)
 {
     AM_SET_COMPILER("clang", "c99");
@@ -26,16 +29,39 @@ static void source_files(const char *source_dir, const char *build_dir,
     AM_SET_TARGET_NAME(target);
 }
 
-int main(void)
+int main(int argc, char **argv)
 {
+    // "./2am headless" makes the windowless platform the only backend,
+    // "./2am test" runs the engine self tests at init. They combine.
+    int headless = 0;
+    int test = 0;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "headless") == 0) headless = 1;
+        if (strcmp(argv[i], "test") == 0) test = 1;
+    }
+
     AM_INIT();
 
     // engine compile setup
     compiler_config();
     source_files("engine/src", "build/engine", "twoam");
 
-    AM_SET_FLAGS("-g, -fPIC, -DAM2_DEBUG, -DAM2_CORE, -fvisibility=hidden");
-    AM_USE_LIB("X11, xcb, X11-xcb, xkbcommon");
+    char flags[256];
+    snprintf(flags, sizeof(flags),
+             "-g, -fPIC, -DAM2_DEBUG, -DAM2_CORE, -fvisibility=hidden%s%s",
+             headless ? ", -DAM2_HEADLESS" : "", test ? ", -DAM2_TESTS" : "");
+    AM_SET_FLAGS(flags);
+
+    if (headless)
+    {
+        // the X backend is compiled out, nothing of it to link
+        AM_USE_LIB("pthread");
+    }
+    else
+    {
+        AM_USE_LIB("X11, xcb, X11-xcb, Xi, xkbcommon, pthread");
+    }
 
     AM_BUILD(BUILD_SHARED, true);
     AM_GEN_DATABASE();
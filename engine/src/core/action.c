@@ -0,0 +1,303 @@
+#include "action.h"
+#include "memory.h"
+#include "platform/platform.h"
+
+#if defined(__x86_64__)
+#    include <immintrin.h>
+#endif
+
+#define ACTION_WORDS (ACTION_MAX / 64)
+#define ACTION_HELD_MODS (MOD_SHIFT | MOD_CTRL | MOD_ALT | MOD_SUPER)
+
+typedef struct {
+    input_mask_t chord;
+    u16 action;
+    u8 mods;
+} binding_t;
+
+// Bindings are edited as a list and compiled into parallel arrays, so a
+// frame is one branch free sweep over plain u64 columns.
+typedef struct {
+    u64 lo[ACTION_BINDING_MAX];
+    u64 hi[ACTION_BINDING_MAX];
+    u8 mods[ACTION_BINDING_MAX];
+    u8 care[ACTION_BINDING_MAX]; // mods bits compared, mods for subset
+    u16 action[ACTION_BINDING_MAX];
+    u32 count;
+} binding_table_t;
+
+// ORs the actions whose bindings are all held into state
+typedef void (*action_match_fn)(const binding_table_t *t, u64 lo, u64 hi,
+                                u8 mods, u64 *state);
+
+typedef struct {
+    const char *names[ACTION_MAX];
+    u32 action_count;
+
+    binding_t bindings[ACTION_BINDING_MAX];
+    u32 binding_count;
+    b8 dirty;
+
+    binding_table_t table;
+
+    u64 state[ACTION_WORDS];
+    u64 prev[ACTION_WORDS];
+
+    action_match_fn match;
+} action_system_t;
+
+static b8 initialized = false;
+static action_system_t g_action = {0};
+
+static INL void action_match_from(const binding_table_t *t, u32 first,
+                                  u64 lo, u64 hi, u8 mods, u64 *state)
+{
+    for (u32 i = first; i < t->count; ++i)
+    {
+        u64 hit = ((lo & t->lo[i]) == t->lo[i]) &
+                  ((hi & t->hi[i]) == t->hi[i]) &
+                  ((mods & t->care[i]) == t->mods[i]);
+        state[t->action[i] >> 6] |= hit << (t->action[i] & 63);
+    }
+}
+
+static void action_match_scalar(const binding_table_t *t, u64 lo, u64 hi,
+                                u8 mods, u64 *state)
+{
+    action_match_from(t, 0, lo, hi, mods, state);
+}
+
+#if defined(__x86_64__)
+// four chords per compare, the mods and the scatter stay scalar
+__attribute__((target("avx2"))) static void
+action_match_avx2(const binding_table_t *t, u64 lo, u64 hi, u8 mods,
+                  u64 *state)
+{
+    const __m256i vlo = _mm256_set1_epi64x((long long)lo);
+    const __m256i vhi = _mm256_set1_epi64x((long long)hi);
+
+    u32 i = 0;
+    for (; i + 4 <= t->count; i += 4)
+    {
+        __m256i clo = _mm256_loadu_si256((const __m256i *)&t->lo[i]);
+        __m256i chi = _mm256_loadu_si256((const __m256i *)&t->hi[i]);
+        __m256i eq =
+            _mm256_and_si256(_mm256_cmpeq_epi64(_mm256_and_si256(vlo, clo),
+                                                clo),
+                             _mm256_cmpeq_epi64(_mm256_and_si256(vhi, chi),
+                                                chi));
+        u32 lanes = (u32)_mm256_movemask_pd(_mm256_castsi256_pd(eq));
+
+        for (u32 j = 0; j < 4; ++j)
+        {
+            u64 hit = ((lanes >> j) & 1) &
+                      ((mods & t->care[i + j]) == t->mods[i + j]);
+            u16 action = t->action[i + j];
+            state[action >> 6] |= hit << (action & 63);
+        }
+    }
+
+    action_match_from(t, i, lo, hi, mods, state);
+}
+#endif
+
+void action_sys_init(void)
+{
+    mem_zero(&g_action, sizeof(g_action));
+
+    // picked once for this CPU
+    g_action.match = action_match_scalar;
+#if defined(__x86_64__)
+    if (platform_cpu_has(CPU_AVX2)) g_action.match = action_match_avx2;
+#endif
+
+    initialized = true;
+    LOGI("Action System Init: %s matching",
+         g_action.match == action_match_scalar ? "scalar" : "avx2");
+}
+
+void action_sys_kill(void)
+{
+    initialized = false;
+    LOGI("Action System Kill");
+}
+
+static INL b8 chord_has(input_mask_t chord, keys key)
+{
+    return (chord.bits[(u32)key >> 6] >> ((u32)key & 63)) & 1;
+}
+
+// modifiers whose keys are part of the chord
+static u8 action_chord_mods(input_mask_t chord)
+{
+    u8 mods = 0;
+    if (chord_has(chord, KEY_SHIFT)) mods |= MOD_SHIFT;
+    if (chord_has(chord, KEY_CTRL)) mods |= MOD_CTRL;
+    if (chord_has(chord, KEY_ALT)) mods |= MOD_ALT;
+    if (chord_has(chord, KEY_SUPER)) mods |= MOD_SUPER;
+    return mods;
+}
+
+static void action_compile(void)
+{
+    binding_table_t *t = &g_action.table;
+
+    for (u32 i = 0; i < g_action.binding_count; ++i)
+    {
+        binding_t *b = &g_action.bindings[i];
+        u8 mods = (u8)(b->mods & ~ACTION_EXACT);
+        u8 care = mods;
+        if (b->mods & ACTION_EXACT)
+        {
+            // the chord's own modifier keys are held by definition
+            u8 own = action_chord_mods(b->chord);
+            care = (u8)(mods | (ACTION_HELD_MODS & ~own));
+        }
+
+        t->lo[i] = b->chord.bits[0];
+        t->hi[i] = b->chord.bits[1];
+        t->mods[i] = mods;
+        t->care[i] = care;
+        t->action[i] = b->action;
+    }
+    t->count = g_action.binding_count;
+
+    g_action.dirty = false;
+}
+
+void action_sys_update(const input_mask_t *down, u8 mods)
+{
+    if (!initialized)
+    {
+        return;
+    }
+    if (g_action.dirty)
+    {
+        action_compile();
+    }
+
+    u64 state[ACTION_WORDS] = {0};
+    const binding_table_t *t = &g_action.table;
+    const u64 lo = down->bits[0];
+    const u64 hi = down->bits[1];
+
+    g_action.match(t, lo, hi, mods, state);
+
+    for (u32 i = 0; i < ACTION_WORDS; ++i)
+    {
+        g_action.prev[i] = g_action.state[i];
+        g_action.state[i] = state[i];
+    }
+}
+
+u16 action_declare(const char *name)
+{
+    if (!initialized || g_action.action_count == ACTION_MAX)
+    {
+        LOGE("Cannot declare action '%s'", name);
+        return ACTION_INVALID;
+    }
+
+    u16 id = (u16)g_action.action_count++;
+    g_action.names[id] = name;
+    return id;
+}
+
+b8 action_bind(u16 action, input_mask_t chord, u8 mods)
+{
+    if (!initialized || action >= g_action.action_count)
+    {
+        return false;
+    }
+    if (g_action.binding_count == ACTION_BINDING_MAX)
+    {
+        LOGE("Action binding table full");
+        return false;
+    }
+    if ((chord.bits[0] | chord.bits[1]) == 0)
+    {
+        // an empty chord would always be down
+        return false;
+    }
+
+    binding_t *b = &g_action.bindings[g_action.binding_count++];
+    b->chord = chord;
+    b->action = action;
+    b->mods = mods;
+
+    g_action.dirty = true;
+    return true;
+}
+
+b8 action_bind_key(u16 action, keys key, u8 mods)
+{
+    return action_bind(action, input_mask_key(key), mods);
+}
+
+b8 action_bind_button(u16 action, mouse_buttons button, u8 mods)
+{
+    return action_bind(action, input_mask_button(button), mods);
+}
+
+void action_unbind_all(u16 action)
+{
+    if (!initialized)
+    {
+        return;
+    }
+
+    u32 kept = 0;
+    for (u32 i = 0; i < g_action.binding_count; ++i)
+    {
+        if (g_action.bindings[i].action != action)
+        {
+            g_action.bindings[kept++] = g_action.bindings[i];
+        }
+    }
+
+    g_action.binding_count = kept;
+    g_action.dirty = true;
+}
+
+static INL b8 action_bit(const u64 *words, u16 action)
+{
+    return (words[action >> 6] >> (action & 63)) & 1;
+}
+
+b8 action_down(u16 action)
+{
+    if (!initialized || action >= ACTION_MAX)
+    {
+        return false;
+    }
+
+    return action_bit(g_action.state, action);
+}
+
+b8 action_pressed(u16 action)
+{
+    if (!initialized || action >= ACTION_MAX)
+    {
+        return false;
+    }
+
+    return action_bit(g_action.state, action) &&
+           !action_bit(g_action.prev, action);
+}
+
+b8 action_released(u16 action)
+{
+    if (!initialized || action >= ACTION_MAX)
+    {
+        return false;
+    }
+
+    return !action_bit(g_action.state, action) &&
+           action_bit(g_action.prev, action);
+}
+
+const char *action_name(u16 action)
+{
+    if (action >= g_action.action_count) return "UNKNOWN";
+    return g_action.names[action];
+}
@@ -0,0 +1,45 @@
+#ifndef ACTION_H
+#define ACTION_H
+
+#include "define.h"
+#include "input.h"
+
+#define ACTION_MAX 256
+#define ACTION_BINDING_MAX 4096
+#define ACTION_INVALID 0xFFFF
+
+void action_sys_init(void);
+
+void action_sys_kill(void);
+
+// OR into the mods of a bind: shift, ctrl, alt and super must then be
+// exactly mods, any extra one held stops the binding
+#define ACTION_EXACT 0x80
+
+// input_sys_update hands over the frame's key/button mask and the mods
+// held in it
+void action_sys_update(const input_mask_t *down, u8 mods);
+
+// name is kept by pointer, returns ACTION_INVALID when full
+AM2_API u16 action_declare(const char *name);
+
+// Action is down while every bit of chord is held and every key_mod bit
+// in mods is active. Mods are a subset test, so a ctrl+S binding also
+// fires on ctrl+shift+S unless mods has ACTION_EXACT. Modifier keys in
+// the chord itself never count as extra. An action can have any number
+// of bindings.
+AM2_API b8 action_bind(u16 action, input_mask_t chord, u8 mods);
+
+AM2_API b8 action_bind_key(u16 action, keys key, u8 mods);
+
+AM2_API b8 action_bind_button(u16 action, mouse_buttons button, u8 mods);
+
+AM2_API void action_unbind_all(u16 action);
+
+AM2_API b8 action_down(u16 action);
+AM2_API b8 action_pressed(u16 action);
+AM2_API b8 action_released(u16 action);
+
+AM2_API const char *action_name(u16 action);
+
+#endif // ACTION_H
@@ -0,0 +1,248 @@
+#include "aio.h"
+#include "event.h"
+#include "platform/platform.h"
+
+#define AIO_MAX_READS 1024 // must be power of two
+#define AIO_QUEUE_DEPTH 256
+#define AIO_POLL_BATCH 64
+// largest single read Linux performs, bigger ones come back short
+#define AIO_MAX_READ_SIZE 0x7FFFF000ULL
+
+typedef enum {
+    AIO_FREE,
+    AIO_BACKLOG, // waiting for room in the platform queue
+    AIO_IN_FLIGHT,
+} aio_state_t;
+
+typedef struct {
+    void *user;
+    void *buffer;
+    u64 size;
+    u64 offset;
+    i32 file;
+    u32 next; // free list, slot index + 1
+    u16 gen;
+    u8 state;
+} aio_read_t;
+
+typedef struct {
+    aio_read_t reads[AIO_MAX_READS];
+    u32 free_head;
+    u32 pending;
+
+    // slot ids in queue order, drained before any new read goes out
+    u32 backlog[AIO_MAX_READS];
+    u32 backlog_head;
+    u32 backlog_count;
+} aio_system_t;
+
+static b8 initialized = false;
+static aio_system_t g_aio = {0};
+
+static INL aio_handle_t aio_make_handle(u32 id)
+{
+    return (aio_handle_t)((u32)g_aio.reads[id - 1].gen << 16 | id);
+}
+
+static u32 aio_lookup(aio_handle_t handle)
+{
+    u32 id = handle & 0xFFFF;
+    if (!initialized || id == 0 || id > AIO_MAX_READS) return 0;
+
+    aio_read_t *read = &g_aio.reads[id - 1];
+    if (read->state == AIO_FREE || read->gen != (u16)(handle >> 16)) return 0;
+    return id;
+}
+
+static b8 aio_issue(u32 id)
+{
+    aio_read_t *read = &g_aio.reads[id - 1];
+    if (!platform_io_read(read->file, read->buffer, read->size, read->offset,
+                          aio_make_handle(id)))
+        return false;
+
+    read->state = AIO_IN_FLIGHT;
+    return true;
+}
+
+static void aio_release(u32 id)
+{
+    aio_read_t *read = &g_aio.reads[id - 1];
+    read->state = AIO_FREE;
+    read->gen++;
+    read->next = g_aio.free_head;
+    g_aio.free_head = id;
+    g_aio.pending--;
+}
+
+b8 aio_sys_init(void)
+{
+    if (initialized)
+    {
+        LOGE("Async IO already initialized");
+        return false;
+    }
+
+    if (!platform_io_init(AIO_QUEUE_DEPTH)) return false;
+
+    mem_zero(&g_aio, sizeof(g_aio));
+    for (u32 id = AIO_MAX_READS; id > 0; --id)
+    {
+        g_aio.reads[id - 1].next = g_aio.free_head;
+        g_aio.free_head = id;
+    }
+
+    initialized = true;
+    LOGI("Async IO System Init");
+    return true;
+}
+
+void aio_sys_kill(void)
+{
+    if (!initialized)
+    {
+        return;
+    }
+
+    if (g_aio.pending)
+    {
+        LOGW("%u file reads dropped at shutdown", g_aio.pending);
+    }
+    platform_io_kill();
+
+    initialized = false;
+    LOGI("Async IO System Kill");
+}
+
+void aio_sys_update(void)
+{
+    if (!initialized)
+    {
+        return;
+    }
+
+    platform_io_result_t results[AIO_POLL_BATCH];
+    u32 count;
+    do
+    {
+        count = platform_io_poll(results, AIO_POLL_BATCH);
+        for (u32 i = 0; i < count; ++i)
+        {
+            aio_handle_t handle = (aio_handle_t)results[i].user;
+            u32 id = aio_lookup(handle);
+            if (!id) continue;
+
+            event_ctx_t ctx = {0};
+            AIO_CTX_HANDLE(ctx) = handle;
+            AIO_CTX_RESULT(ctx) = results[i].result;
+            void *user = g_aio.reads[id - 1].user;
+
+            // stale before the handlers run, they may queue the next read
+            aio_release(id);
+            event_post(EV_FILE_READ, user, ctx);
+        }
+    } while (count == AIO_POLL_BATCH);
+
+    // completions made room for the backlog
+    aio_submit();
+}
+
+i32 aio_open(const char *path, u32 flags)
+{
+    return platform_file_open(path, flags);
+}
+
+void aio_close(i32 file)
+{
+    platform_file_close(file);
+}
+
+u64 aio_file_size(i32 file)
+{
+    return platform_file_size(file);
+}
+
+aio_handle_t aio_read(i32 file, void *buffer, u64 size, u64 offset,
+                      void *user)
+{
+    if (!initialized || file < 0 || !buffer)
+    {
+        return 0;
+    }
+    if (size > AIO_MAX_READ_SIZE)
+    {
+        LOGE("File read of %llu bytes too large, split it", size);
+        return 0;
+    }
+    if (!g_aio.free_head)
+    {
+        LOGE("Async read limit %u reached", AIO_MAX_READS);
+        return 0;
+    }
+
+    u32 id = g_aio.free_head;
+    aio_read_t *read = &g_aio.reads[id - 1];
+    g_aio.free_head = read->next;
+    g_aio.pending++;
+
+    read->user = user;
+    read->buffer = buffer;
+    read->size = size;
+    read->offset = offset;
+    read->file = file;
+    read->next = 0;
+
+    // keep queue order, nothing overtakes the backlog
+    if (g_aio.backlog_count || !aio_issue(id))
+    {
+        u32 slot = (g_aio.backlog_head + g_aio.backlog_count) &
+                   (AIO_MAX_READS - 1);
+        g_aio.backlog[slot] = id;
+        g_aio.backlog_count++;
+        read->state = AIO_BACKLOG;
+    }
+
+    return aio_make_handle(id);
+}
+
+void aio_submit(void)
+{
+    if (!initialized)
+    {
+        return;
+    }
+
+    while (g_aio.backlog_count && aio_issue(g_aio.backlog[g_aio.backlog_head]))
+    {
+        g_aio.backlog_head = (g_aio.backlog_head + 1) & (AIO_MAX_READS - 1);
+        g_aio.backlog_count--;
+    }
+
+    platform_io_submit();
+}
+
+b8 aio_busy(aio_handle_t handle)
+{
+    return aio_lookup(handle) != 0;
+}
+
+u32 aio_pending(void)
+{
+    return g_aio.pending;
+}
+
+static u64 aio_buffer_size(u64 size)
+{
+    u64 pages = (size + PLATFORM_PAGE_SIZE - 1) / PLATFORM_PAGE_SIZE;
+    return (pages ? pages : 1) * PLATFORM_PAGE_SIZE;
+}
+
+void *aio_buffer_alloc(u64 size, memtag_t tag)
+{
+    return mem_alloc_aligned(aio_buffer_size(size), tag);
+}
+
+void aio_buffer_free(void *buffer, u64 size, memtag_t tag)
+{
+    mem_free_aligned(buffer, aio_buffer_size(size), tag);
+}
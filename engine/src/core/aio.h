@@ -0,0 +1,54 @@
+#ifndef AIO_H
+#define AIO_H
+
+#include "define.h"
+#include "memory.h"
+
+// 0 is never a valid handle, a finished read's handle goes stale
+typedef u32 aio_handle_t;
+
+// A finished read posts EV_FILE_READ with the reader's user pointer as
+// sender. ctx.data.u32[0] is the handle, ctx.data.i64[1] the bytes read
+// or a negative errno.
+#define AIO_CTX_HANDLE(ctx) ((ctx).data.u32[0])
+#define AIO_CTX_RESULT(ctx) ((ctx).data.i64[1])
+
+b8 aio_sys_init(void);
+
+void aio_sys_kill(void);
+
+// submit queued reads and post finished ones, once per frame
+void aio_sys_update(void);
+
+// blocking, opening is cheap next to the reads. flags take FILE_DIRECT,
+// returns -1 on failure
+AM2_API i32 aio_open(const char *path, u32 flags);
+
+AM2_API void aio_close(i32 file);
+
+AM2_API u64 aio_file_size(i32 file);
+
+// Queue a read of size bytes at offset into buffer, which must stay
+// valid until its event. Goes out with the next aio_sys_update or
+// aio_submit, batched with every other read queued until then. Reads of
+// a FILE_DIRECT file need buffer, offset and size PLATFORM_PAGE_SIZE
+// aligned, else they fail with -EINVAL.
+AM2_API aio_handle_t aio_read(i32 file, void *buffer, u64 size, u64 offset,
+                              void *user);
+
+// send queued reads now instead of at the next update
+AM2_API void aio_submit(void);
+
+AM2_API b8 aio_busy(aio_handle_t handle);
+
+// reads queued or in flight
+AM2_API u32 aio_pending(void);
+
+// zeroed, page aligned and rounded up to whole pages, fit for
+// FILE_DIRECT. Counted against tag like mem_alloc.
+AM2_API void *aio_buffer_alloc(u64 size, memtag_t tag);
+
+// same size and tag as the alloc
+AM2_API void aio_buffer_free(void *buffer, u64 size, memtag_t tag);
+
+#endif // AIO_H
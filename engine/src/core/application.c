@@ -2,18 +2,104 @@
 #include "memory.h"
 #include "event.h"
 #include "input.h"
-
+#include "trace.h"
+#include "action.h"
+#include "latency.h"
+#include "job.h"
+#include "coro.h"
+#include "aio.h"
+
+#if defined(AM2_TESTS)
 #include "container/test_darray.h"
+#include "core/test_event.h"
+#include "core/test_job.h"
+#endif
 
 static b8 initialized = false;
 static application_t g_app = {0};
+static event_handle_t g_app_events[5] = {0};
 
 b8 application_on_event(u16 code, void *sender, void *recipient,
                         event_ctx_t ctx);
 
+b8 application_on_window(u16 code, void *sender, void *recipient,
+                         event_ctx_t ctx);
+
 b8 application_on_key(u16 code, void *sender, void *recipient,
                       event_ctx_t ctx);
 
+// below this much time left the limiter spins, sleep wakes up too late
+#define FRAME_SPIN_TIME 0.001
+
+// No cap: rather than spin a core on frames with nothing to step, wait
+// until the next update is due. Input and platform_wake still end the
+// wait, so the loop answers them early.
+static void application_wait_step(void)
+{
+    if (g_app.on_demand || g_app.is_suspended)
+    {
+        return;
+    }
+
+    f64 remaining = g_app.fixed_step - g_app.accumulator;
+    if (remaining > 0.0)
+    {
+        platform_wait(&g_app.platform, remaining);
+    }
+}
+
+static void application_wait_frame(void)
+{
+    // replay runs flat out, its frame times are the build's own cost
+    if (trace_get_mode() == TRACE_REPLAY)
+    {
+        return;
+    }
+    if (g_app.frame_time <= 0.0)
+    {
+        application_wait_step();
+        return;
+    }
+
+    f64 remaining = g_app.frame_deadline - platform_get_time();
+    if (remaining > FRAME_SPIN_TIME)
+    {
+        platform_sleep((u64)((remaining - FRAME_SPIN_TIME) * 1000.0));
+    }
+    while (platform_get_time() < g_app.frame_deadline)
+    {
+    }
+
+    // fell a whole frame behind (hitch, debugger), restart the cadence
+    // instead of rushing frames to catch up
+    g_app.frame_deadline += g_app.frame_time;
+    f64 now = platform_get_time();
+    if (g_app.frame_deadline < now)
+    {
+        g_app.frame_deadline = now + g_app.frame_time;
+    }
+}
+
+// Render on demand: block on the platform until input, platform_wake or
+// a requested frame is due. The frame cap still applies after.
+static void application_idle(void)
+{
+    f64 now = platform_get_time();
+    if (g_app.wake_time < 0.0 || g_app.wake_time > now)
+    {
+        f64 timeout = g_app.wake_time < 0.0 ? -1.0 : g_app.wake_time - now;
+        platform_wait(&g_app.platform, timeout);
+        now = platform_get_time();
+    }
+    if (g_app.wake_time >= 0.0 && g_app.wake_time <= now)
+    {
+        g_app.wake_time = -1.0;
+    }
+
+    // idle time is not simulated, the woken frame runs a single step
+    g_app.last_time = now - g_app.fixed_step;
+}
+
 b8 application_init(game_entry_t *game_instance)
 {
     if (initialized)
@@ -24,12 +110,25 @@ b8 application_init(game_entry_t *game_instance)
 
     memory_sys_init(MEBIBYTE);
 
+    // logs the CPU, kernels below pick their implementation from it
+    platform_get_cpu_info();
+    // calibrate now, ticks switch clocks once this ran
+    platform_get_tick_frequency();
+
     g_app.game = game_instance;
 
     g_app.is_running = true;
     g_app.is_suspended = false;
+    g_app.is_focused = true;
+
+    application_config_t *config = &game_instance->config;
+    u32 update_rate = config->update_rate ? config->update_rate : 60;
+    g_app.fixed_step = 1.0 / (f64)update_rate;
+    g_app.max_steps = config->max_update_steps ? config->max_update_steps : 5;
 
     input_sys_init();
+    action_sys_init();
+    latency_sys_init();
 
     if (!event_sys_init())
     {
@@ -37,6 +136,26 @@ b8 application_init(game_entry_t *game_instance)
         return false;
     }
 
+    if (!job_sys_init(0))
+    {
+        LOGE("Job failed to initialized");
+        return false;
+    }
+
+    if (!coro_sys_init())
+    {
+        LOGE("Coroutine failed to initialized");
+        return false;
+    }
+
+    if (!trace_sys_init(game_instance->config.trace_record,
+                        game_instance->config.trace_replay))
+    {
+        LOGE("Trace failed to initialized");
+        return false;
+    }
+
+    g_app.platform.headless = game_instance->config.headless;
     if (!platform_init(&g_app.platform, game_instance->config.name,
                        (i16)game_instance->config.width,
                        (i16)game_instance->config.height))
@@ -45,6 +164,13 @@ b8 application_init(game_entry_t *game_instance)
         return false;
     }
 
+    // after the platform, completions wake its idle wait
+    if (!aio_sys_init())
+    {
+        LOGE("Async IO failed to initialized");
+        return false;
+    }
+
     if (!g_app.game->init(g_app.game))
     {
         LOGF("Game failed to initialized");
@@ -52,13 +178,24 @@ b8 application_init(game_entry_t *game_instance)
     }
     g_app.game->resize(g_app.game, g_app.width, g_app.height);
 
-    event_reg(EV_APP_QUIT, 0, application_on_event);
-    event_reg(EV_KEY_PRESSED, 0, application_on_key);
-    event_reg(EV_KEY_RELEASED, 0, application_on_key);
+    g_app_events[0] = event_reg(EV_APP_QUIT, 0, application_on_event);
+    g_app_events[1] = event_reg(EV_KEY_PRESSED, 0, application_on_key);
+    g_app_events[2] = event_reg(EV_KEY_RELEASED, 0, application_on_key);
+    g_app_events[3] =
+        event_reg(EV_VISIBILITY_CHANGED, 0, application_on_window);
+    g_app_events[4] = event_reg(EV_FOCUS_CHANGED, 0, application_on_window);
 
     initialized = true;
+    g_app.background_fps = config->background_fps;
+    application_set_target_fps(config->target_fps);
+    application_set_render_on_demand(config->render_on_demand);
 
-    // dynamic_array_test();
+#if defined(AM2_TESTS)
+    // "./2am test" builds
+    dynamic_array_test();
+    event_async_test();
+    job_test();
+#endif
 
     LOGI("Engine Initialized");
     return true;
@@ -68,42 +205,113 @@ b8 application_run(void)
 {
     LOGI(get_usage_mem());
 
+    g_app.last_time = platform_get_time();
+    g_app.frame_deadline = g_app.last_time + g_app.frame_time;
+
     while (g_app.is_running)
     {
-        if (!platform_pump(&g_app.platform))
+        // a minimized window sleeps until the platform has something
+        if ((g_app.on_demand || g_app.is_suspended) &&
+            trace_get_mode() != TRACE_REPLAY)
+        {
+            application_idle();
+        }
+
+        f64 now = platform_get_time();
+        f64 delta = now - g_app.last_time;
+        g_app.last_time = now;
+
+        // replay steps on the recorded deltas, not this run's clock
+        g_app.delta = trace_frame(g_app.frame_index, delta);
+
+        if (trace_get_mode() == TRACE_REPLAY)
+        {
+            // recorded input stands in for the platform
+            if (!trace_replay_frame())
+            {
+                g_app.is_running = false;
+            }
+        }
+        else if (!platform_pump(&g_app.platform))
         {
             g_app.is_running = false;
         }
 
+        // reads finished since last frame post their events here
+        aio_sys_update();
+
+        // platform only queued events, handlers run here
+        event_flush();
+
         if (!g_app.is_suspended)
         {
-            if (!g_app.game->update(g_app.game, (f32)0))
+            g_app.accumulator += g_app.delta;
+
+            // input advances with each step so edges fire exactly once,
+            // a frame with no step keeps them for the next one
+            u32 steps = 0;
+            while (g_app.accumulator >= g_app.fixed_step &&
+                   steps < g_app.max_steps)
             {
-                LOGF("Game update failed, shutting down");
-                g_app.is_running = false;
-                break;
+                input_sys_update(g_app.fixed_step);
+
+                if (!g_app.game->update(g_app.game, (f32)g_app.fixed_step))
+                {
+                    LOGF("Game update failed, shutting down");
+                    g_app.is_running = false;
+                    break;
+                }
+                // scripts continue after the game logic of the step
+                coro_sys_update();
+
+                g_app.accumulator -= g_app.fixed_step;
+                steps++;
             }
+            if (!g_app.is_running) break;
+            if (steps) latency_frame_consumed();
 
-            if (!g_app.game->render(g_app.game, (f32)0))
+            // out of catch-up steps, drop the backlog but keep the phase
+            if (g_app.accumulator >= g_app.fixed_step)
+            {
+                u64 behind = (u64)(g_app.accumulator / g_app.fixed_step);
+                g_app.accumulator -= (f64)behind * g_app.fixed_step;
+            }
+
+            f32 alpha = (f32)(g_app.accumulator / g_app.fixed_step);
+            if (!g_app.game->render(g_app.game, alpha))
             {
                 LOGF("Game render failed, shutting down");
                 g_app.is_running = false;
                 break;
             }
-
-            input_sys_update(0);
         }
+        else
+        {
+            // nothing simulated while suspended, do not catch up after
+            g_app.accumulator = 0.0;
+        }
+
+        g_app.frame_index++;
+        application_wait_frame();
     }
 
     g_app.is_running = false;
 
-    event_unreg(EV_APP_QUIT, 0, application_on_event);
-    event_unreg(EV_KEY_PRESSED, 0, application_on_key);
-    event_unreg(EV_KEY_RELEASED, 0, application_on_key);
+    for (u32 i = 0; i < sizeof(g_app_events) / sizeof(g_app_events[0]); ++i)
+    {
+        event_unreg(g_app_events[i]);
+    }
 
+    LOGI(get_latency_report());
+    aio_sys_kill();
     platform_kill(&g_app.platform);
 
+    trace_sys_kill();
+    job_sys_kill();
+    coro_sys_kill();
     event_sys_kill();
+    action_sys_kill();
+    latency_sys_kill();
     input_sys_kill();
 
     // free memory from game side
@@ -115,6 +323,62 @@ b8 application_run(void)
     return true;
 }
 
+// unfocused windows run at the background rate when one is set
+static void application_apply_fps(void)
+{
+    u32 fps = g_app.target_fps;
+    if (!g_app.is_focused && g_app.background_fps)
+    {
+        if (fps == 0 || g_app.background_fps < fps) fps = g_app.background_fps;
+    }
+
+    g_app.frame_time = fps ? 1.0 / (f64)fps : 0.0;
+    g_app.frame_deadline = platform_get_time() + g_app.frame_time;
+}
+
+void application_set_target_fps(u32 fps)
+{
+    g_app.target_fps = fps;
+    application_apply_fps();
+}
+
+void application_set_background_fps(u32 fps)
+{
+    g_app.background_fps = fps;
+    application_apply_fps();
+}
+
+void application_set_render_on_demand(b8 on_demand)
+{
+    g_app.on_demand = on_demand;
+    // draw once right away so the screen reflects the switch
+    g_app.wake_time = 0.0;
+}
+
+void application_request_frame(f64 delay)
+{
+    f64 when = platform_get_time() + delay;
+    if (g_app.wake_time < 0.0 || when < g_app.wake_time)
+    {
+        g_app.wake_time = when;
+    }
+}
+
+f64 application_get_delta(void)
+{
+    return g_app.delta;
+}
+
+void application_set_mouse_grab(b8 grab)
+{
+    if (!initialized)
+    {
+        return;
+    }
+
+    platform_set_mouse_grab(&g_app.platform, grab);
+}
+
 b8 application_on_event(u16 code, void *sender, void *recipient,
                         event_ctx_t ctx)
 {
@@ -135,6 +399,35 @@ b8 application_on_event(u16 code, void *sender, void *recipient,
     return false;
 }
 
+b8 application_on_window(u16 code, void *sender, void *recipient,
+                         event_ctx_t ctx)
+{
+    (void)sender;
+    (void)recipient;
+
+    // one code per property carrying its final state, so the order of
+    // dispatch within a frame cannot leave a stale value behind
+    b8 state = ctx.data.u8[0] != 0;
+    switch (code)
+    {
+    case EV_VISIBILITY_CHANGED:
+        if (state == g_app.is_suspended)
+        {
+            LOGD(state ? "Window restored, resumed"
+                       : "Window minimized, suspended");
+        }
+        g_app.is_suspended = !state;
+        break;
+    case EV_FOCUS_CHANGED:
+        g_app.is_focused = state;
+        application_apply_fps();
+        break;
+    }
+
+    // game handlers registered for these still run
+    return false;
+}
+
 b8 application_on_key(u16 code, void *sender, void *recipient, event_ctx_t ctx)
 {
     (void)sender;
@@ -16,6 +16,23 @@ typedef struct {
     u32 width;
     u32 height;
     f64 last_time;
+    u64 frame_index;
+
+    b8 is_focused;
+    u32 target_fps;
+    u32 background_fps;
+
+    // frame clock, all in seconds
+    f64 frame_time;     // target frame duration, 0 paces to updates
+    f64 frame_deadline; // when the current frame should end
+    f64 fixed_step;
+    f64 accumulator; // simulation time not yet stepped
+    f64 delta;       // real time of the last frame
+    u32 max_steps;
+
+    // render on demand, frames only run on input or a requested wake
+    b8 on_demand;
+    f64 wake_time; // negative when no frame is requested
 
     platform_system_t platform;
 } application_t;
@@ -24,4 +41,23 @@ AM2_API b8 application_init(game_entry_t *game_instance);
 
 AM2_API b8 application_run(void);
 
+// 0 paces frames to the update rate instead of a frame cap
+AM2_API void application_set_target_fps(u32 fps);
+
+// cap used while the window is unfocused, 0 keeps the target rate
+AM2_API void application_set_background_fps(u32 fps);
+
+// only run a frame when input arrives, platform_wake is called or a
+// requested frame is due, for tools and paused menus
+AM2_API void application_set_render_on_demand(b8 on_demand);
+
+// with render on demand, run a frame after delay seconds (0 = next one)
+AM2_API void application_request_frame(f64 delay);
+
+// real time of the last frame, updates always get the fixed step
+AM2_API f64 application_get_delta(void);
+
+// hide and confine the pointer, read motion with input_get_mouse_delta
+AM2_API void application_set_mouse_grab(b8 grab);
+
 #endif // APPLICATION_H
@@ -0,0 +1,528 @@
+// ucontext is XSI, only the fallback switch below needs it
+#if !defined(__x86_64__)
+#    define _XOPEN_SOURCE 700
+#endif
+#include "coro.h"
+#include "memory.h"
+
+// x86_64 switches with the few instructions below, other targets fall
+// back to ucontext, which also saves the signal mask per switch
+#if defined(__x86_64__)
+#    define CORO_ASM_SWITCH 1
+#else
+#    define CORO_ASM_SWITCH 0
+#    include <ucontext.h>
+#endif
+
+#define CORO_MAX 4096
+// LOG* alone takes ~8 KiB of buffers, leave room for real call chains.
+// Only touched pages are committed, a guard page catches the rest.
+#define CORO_STACK_SIZE (64 * KIBIBYTE)
+#define CORO_EVENT_SLOTS 64
+#define CORO_CANARY 0xC0C0DEADBEEFC0C0ULL
+
+#if CORO_ASM_SWITCH
+// Saves the callee-saved registers on the current stack, stores the
+// stack pointer in *from and continues on the stack in to. Everything
+// else is caller-saved in the SysV ABI, so the compiler already spilled
+// it around the call. The MXCSR and x87 control words are callee-saved
+// too, they share the lowest slot of the frame.
+void am2_coro_switch(void **from, void *to);
+
+__asm__(".text\n"
+        ".globl am2_coro_switch\n"
+        ".hidden am2_coro_switch\n"
+        ".type am2_coro_switch, @function\n"
+        "am2_coro_switch:\n"
+        "    pushq %rbp\n"
+        "    pushq %rbx\n"
+        "    pushq %r12\n"
+        "    pushq %r13\n"
+        "    pushq %r14\n"
+        "    pushq %r15\n"
+        "    subq $8, %rsp\n"
+        "    stmxcsr (%rsp)\n"
+        "    fnstcw 4(%rsp)\n"
+        "    movq %rsp, (%rdi)\n"
+        "    movq %rsi, %rsp\n"
+        "    ldmxcsr (%rsp)\n"
+        "    fldcw 4(%rsp)\n"
+        "    addq $8, %rsp\n"
+        "    popq %r15\n"
+        "    popq %r14\n"
+        "    popq %r13\n"
+        "    popq %r12\n"
+        "    popq %rbx\n"
+        "    popq %rbp\n"
+        "    ret\n"
+        ".size am2_coro_switch, .-am2_coro_switch\n");
+
+// the saved stack pointer, the frame on that stack holds the rest
+typedef void *coro_ctx_t;
+
+static INL void coro_switch(coro_ctx_t *from, coro_ctx_t *to)
+{
+    am2_coro_switch(from, *to);
+}
+#else
+typedef ucontext_t coro_ctx_t;
+
+static INL void coro_switch(coro_ctx_t *from, coro_ctx_t *to)
+{
+    swapcontext(from, to);
+}
+#endif
+
+typedef enum {
+    CORO_FREE,
+    CORO_READY,   // in the ready list
+    CORO_WAITING, // in a sleep or event list
+    CORO_RUNNING,
+    CORO_DONE,
+} coro_state_t;
+
+// doubly linked through slot index + 1, 0 ends the list
+typedef struct {
+    u32 head;
+    u32 tail;
+} coro_list_t;
+
+typedef struct {
+    coro_ctx_t ctx;
+    u8 *stack;
+    coro_fn fn;
+    void *arg;
+    coro_list_t *list;
+    u32 next;
+    u32 prev;
+    u32 wake_frame;
+    u16 gen;
+    u8 state;
+    event_ctx_t result;
+} coroutine_t;
+
+typedef struct {
+    u16 code;
+    event_handle_t handle;
+    coro_list_t waiters;
+} coro_event_slot_t;
+
+typedef struct {
+    coroutine_t *slots;
+    u32 free_head; // through next
+    u32 count;
+
+    coro_list_t ready;
+    coro_list_t sleeping;
+    coro_event_slot_t events[CORO_EVENT_SLOTS];
+    u32 event_slots;
+
+    // finished stacks for reuse, linked through their first bytes
+    u8 *free_stacks;
+    u32 stacks_allocated;
+
+    u32 frame;
+    u32 current; // slot + 1 of the running coroutine
+    coro_ctx_t main_ctx;
+} coro_system_t;
+
+static b8 initialized = false;
+static coro_system_t g_coro = {0};
+
+static INL coroutine_t *coro_at(u32 id)
+{
+    return &g_coro.slots[id - 1];
+}
+
+static void list_push(coro_list_t *list, u32 id)
+{
+    coroutine_t *co = coro_at(id);
+    co->list = list;
+    co->next = 0;
+    co->prev = list->tail;
+
+    if (list->tail)
+        coro_at(list->tail)->next = id;
+    else
+        list->head = id;
+    list->tail = id;
+}
+
+static void list_remove(u32 id)
+{
+    coroutine_t *co = coro_at(id);
+    coro_list_t *list = co->list;
+    if (!list) return;
+
+    if (co->prev)
+        coro_at(co->prev)->next = co->next;
+    else
+        list->head = co->next;
+
+    if (co->next)
+        coro_at(co->next)->prev = co->prev;
+    else
+        list->tail = co->prev;
+
+    co->list = 0;
+    co->next = 0;
+    co->prev = 0;
+}
+
+static u8 *stack_acquire(void)
+{
+    u8 *stack = g_coro.free_stacks;
+    if (stack)
+    {
+        g_coro.free_stacks = *(u8 **)stack;
+    }
+    else
+    {
+        stack = mem_alloc_stack(CORO_STACK_SIZE, MEM_ENGINE);
+        if (!stack) return 0;
+        g_coro.stacks_allocated++;
+    }
+
+    // lowest word, catches frames big enough to jump the guard page
+    *(u64 *)stack = CORO_CANARY;
+    return stack;
+}
+
+static void stack_release(u8 *stack)
+{
+    *(u8 **)stack = g_coro.free_stacks;
+    g_coro.free_stacks = stack;
+}
+
+static void coro_release(u32 id)
+{
+    coroutine_t *co = coro_at(id);
+    list_remove(id);
+    stack_release(co->stack);
+
+    co->stack = 0;
+    co->state = CORO_FREE;
+    co->gen++;
+    co->next = g_coro.free_head;
+    g_coro.free_head = id;
+    g_coro.count--;
+}
+
+// first code a new coroutine runs, entered through the ret of the switch
+static void coro_entry(void)
+{
+    coroutine_t *co = coro_at(g_coro.current);
+    co->fn(co->arg);
+
+    co->state = CORO_DONE;
+    coro_switch(&co->ctx, &g_coro.main_ctx);
+    // a finished coroutine is never resumed
+}
+
+static void coro_resume(u32 id)
+{
+    coroutine_t *co = coro_at(id);
+    list_remove(id);
+    co->state = CORO_RUNNING;
+
+    g_coro.current = id;
+    coro_switch(&g_coro.main_ctx, &co->ctx);
+    g_coro.current = 0;
+
+    if (*(u64 *)co->stack != CORO_CANARY)
+    {
+        LOGF("Coroutine %u overflowed its %llu byte stack", id,
+             CORO_STACK_SIZE);
+        AM2_ASSERT(false);
+    }
+
+    if (co->state == CORO_DONE) coro_release(id);
+}
+
+// hand control back to coro_sys_update
+static void coro_suspend(void)
+{
+    coroutine_t *co = coro_at(g_coro.current);
+    coro_switch(&co->ctx, &g_coro.main_ctx);
+}
+
+static b8 coro_event_wake(u16 code, void *sender, void *recipient,
+                          event_ctx_t ctx)
+{
+    (void)code;
+    (void)sender;
+
+    coro_event_slot_t *slot = (coro_event_slot_t *)recipient;
+    while (slot->waiters.head)
+    {
+        u32 id = slot->waiters.head;
+        coroutine_t *co = coro_at(id);
+        list_remove(id);
+
+        co->result = ctx;
+        co->state = CORO_READY;
+        list_push(&g_coro.ready, id);
+    }
+
+    // other handlers still see the event
+    return false;
+}
+
+b8 coro_sys_init(void)
+{
+    if (initialized)
+    {
+        return false;
+    }
+
+    mem_zero(&g_coro, sizeof(g_coro));
+    g_coro.slots = mem_alloc(sizeof(coroutine_t) * CORO_MAX, MEM_ENGINE);
+
+    for (u32 i = CORO_MAX; i > 0; --i)
+    {
+        g_coro.slots[i - 1].next = g_coro.free_head;
+        g_coro.free_head = i;
+    }
+
+    initialized = true;
+    LOGI("Coroutine System Init");
+    return true;
+}
+
+void coro_sys_kill(void)
+{
+    if (!initialized)
+    {
+        return;
+    }
+
+    for (u32 i = 0; i < g_coro.event_slots; ++i)
+    {
+        event_unreg(g_coro.events[i].handle);
+    }
+
+    for (u32 id = 1; id <= CORO_MAX; ++id)
+    {
+        if (coro_at(id)->state != CORO_FREE) coro_release(id);
+    }
+
+    while (g_coro.free_stacks)
+    {
+        u8 *stack = g_coro.free_stacks;
+        g_coro.free_stacks = *(u8 **)stack;
+        mem_free_stack(stack, CORO_STACK_SIZE, MEM_ENGINE);
+    }
+
+    mem_free(g_coro.slots, sizeof(coroutine_t) * CORO_MAX, MEM_ENGINE);
+    mem_zero(&g_coro, sizeof(g_coro));
+
+    initialized = false;
+    LOGI("Coroutine System Kill");
+}
+
+void coro_sys_update(void)
+{
+    if (!initialized || g_coro.count == 0)
+    {
+        return;
+    }
+
+    g_coro.frame++;
+
+    u32 id = g_coro.sleeping.head;
+    while (id)
+    {
+        coroutine_t *co = coro_at(id);
+        u32 next = co->next;
+        if ((i32)(g_coro.frame - co->wake_frame) >= 0)
+        {
+            list_remove(id);
+            co->state = CORO_READY;
+            list_push(&g_coro.ready, id);
+        }
+        id = next;
+    }
+
+    // yields during this pass land in the fresh ready list for next time
+    coro_list_t run = g_coro.ready;
+    g_coro.ready.head = 0;
+    g_coro.ready.tail = 0;
+    for (id = run.head; id; id = coro_at(id)->next)
+    {
+        coro_at(id)->list = &run;
+    }
+
+    while (run.head)
+    {
+        coro_resume(run.head);
+    }
+}
+
+#if CORO_ASM_SWITCH
+static void coro_ctx_init(coroutine_t *co)
+{
+    // Initial frame popped by the first switch: the control words of
+    // the starting thread, six zeroed callee-saved registers, then
+    // coro_entry as return address. The slot above is a fake return
+    // address for coro_entry, which leaves rsp at 8 mod 16 on entry as
+    // the ABI expects.
+    u32 mxcsr = __builtin_ia32_stmxcsr();
+    u16 fpucw = 0;
+    __asm__ volatile("fnstcw %0" : "=m"(fpucw));
+
+    u64 *top = (u64 *)(co->stack + CORO_STACK_SIZE);
+    top[-1] = 0;
+    top[-2] = (u64)(uptr)coro_entry;
+    for (u32 i = 3; i <= 8; ++i)
+    {
+        top[-(i32)i] = 0;
+    }
+    top[-9] = (u64)mxcsr | (u64)fpucw << 32;
+    co->ctx = &top[-9];
+}
+#else
+static void coro_ctx_init(coroutine_t *co)
+{
+    // the first swapcontext enters coro_entry on the coroutine's stack
+    getcontext(&co->ctx);
+    co->ctx.uc_stack.ss_sp = co->stack;
+    co->ctx.uc_stack.ss_size = CORO_STACK_SIZE;
+    co->ctx.uc_link = 0;
+    makecontext(&co->ctx, coro_entry, 0);
+}
+#endif
+
+coro_handle_t coro_start(coro_fn fn, void *arg)
+{
+    if (!initialized || !fn)
+    {
+        return 0;
+    }
+    if (!g_coro.free_head)
+    {
+        LOGE("Coroutine limit %u reached", CORO_MAX);
+        return 0;
+    }
+
+    u8 *stack = stack_acquire();
+    if (!stack)
+    {
+        return 0;
+    }
+
+    u32 id = g_coro.free_head;
+    coroutine_t *co = coro_at(id);
+    g_coro.free_head = co->next;
+    g_coro.count++;
+
+    co->fn = fn;
+    co->arg = arg;
+    co->stack = stack;
+    co->state = CORO_READY;
+    mem_zero(&co->result, sizeof(co->result));
+
+    coro_ctx_init(co);
+
+    list_push(&g_coro.ready, id);
+    return (coro_handle_t)((u32)co->gen << 16 | id);
+}
+
+static u32 coro_lookup(coro_handle_t handle)
+{
+    u32 id = handle & 0xFFFF;
+    if (!initialized || id == 0 || id > CORO_MAX) return 0;
+
+    coroutine_t *co = coro_at(id);
+    if (co->state == CORO_FREE || co->gen != (u16)(handle >> 16)) return 0;
+    return id;
+}
+
+void coro_stop(coro_handle_t handle)
+{
+    u32 id = coro_lookup(handle);
+    if (!id) return;
+
+    if (id == g_coro.current)
+    {
+        LOGE("Coroutine cannot stop itself, return from it instead");
+        return;
+    }
+    coro_release(id);
+}
+
+b8 coro_alive(coro_handle_t handle)
+{
+    return coro_lookup(handle) != 0;
+}
+
+u32 coro_count(void)
+{
+    return g_coro.count;
+}
+
+void coro_yield(void)
+{
+    coro_wait_frames(1);
+}
+
+void coro_wait_frames(u32 frames)
+{
+    if (!g_coro.current)
+    {
+        LOGE("coro_wait_frames called outside a coroutine");
+        return;
+    }
+
+    u32 id = g_coro.current;
+    coroutine_t *co = coro_at(id);
+    if (frames <= 1)
+    {
+        co->state = CORO_READY;
+        list_push(&g_coro.ready, id);
+    }
+    else
+    {
+        co->state = CORO_WAITING;
+        co->wake_frame = g_coro.frame + frames;
+        list_push(&g_coro.sleeping, id);
+    }
+    coro_suspend();
+}
+
+event_ctx_t coro_wait_event(u16 code)
+{
+    event_ctx_t none = {0};
+    if (!g_coro.current)
+    {
+        LOGE("coro_wait_event called outside a coroutine");
+        return none;
+    }
+
+    // one handler per awaited code, kept until shutdown
+    coro_event_slot_t *slot = 0;
+    for (u32 i = 0; i < g_coro.event_slots; ++i)
+    {
+        if (g_coro.events[i].code == code) slot = &g_coro.events[i];
+    }
+    if (!slot)
+    {
+        if (g_coro.event_slots == CORO_EVENT_SLOTS)
+        {
+            LOGE("Coroutines wait on more than %u event codes",
+                 CORO_EVENT_SLOTS);
+            return none;
+        }
+        slot = &g_coro.events[g_coro.event_slots++];
+        slot->code = code;
+        // first in line, a handler returning true must not strand waiters
+        slot->handle = event_reg_system(code, slot, coro_event_wake);
+    }
+
+    u32 id = g_coro.current;
+    coroutine_t *co = coro_at(id);
+    co->state = CORO_WAITING;
+    list_push(&slot->waiters, id);
+    coro_suspend();
+
+    return co->result;
+}
@@ -0,0 +1,41 @@
+#ifndef CORO_H
+#define CORO_H
+
+#include "define.h"
+#include "event.h"
+
+// 0 is never a valid handle, a finished coroutine's handle goes stale
+typedef u32 coro_handle_t;
+
+typedef void (*coro_fn)(void *arg);
+
+b8 coro_sys_init(void);
+
+void coro_sys_kill(void);
+
+// resume every coroutine that is due, once per update step
+void coro_sys_update(void);
+
+// Starts running on the next coro_sys_update. Each coroutine has a 64 KiB
+// stack; going past it faults on the guard page below.
+AM2_API coro_handle_t coro_start(coro_fn fn, void *arg);
+
+// drop a suspended coroutine, its stack is not unwound
+AM2_API void coro_stop(coro_handle_t handle);
+
+AM2_API b8 coro_alive(coro_handle_t handle);
+
+AM2_API u32 coro_count(void);
+
+// the calls below only work from inside a coroutine
+
+// resume on the next update
+AM2_API void coro_yield(void);
+
+// resume after frames more updates, 1 is the same as coro_yield
+AM2_API void coro_wait_frames(u32 frames);
+
+// resume once code is dispatched, returns that event's ctx
+AM2_API event_ctx_t coro_wait_event(u16 code);
+
+#endif // CORO_H
@@ -1,25 +1,161 @@
 #include "event.h"
+#include "latency.h"
 #include "memory.h"
 #include "container/darray.h"
+#include "platform/platform.h"
 
-#define MAX_MSG_CODE 8192
+#include <stdio.h>
 
+// codes split into 256 pages of 256, page 0 holds the engine codes
+#define EVENT_PAGE_SHIFT 8
+#define EVENT_PAGE_SIZE (1 << EVENT_PAGE_SHIFT)
+#define EVENT_PAGE_COUNT (0x10000 >> EVENT_PAGE_SHIFT)
+#define EVENT_QUEUE_SIZE 1024 // must be power of two
+#define EVENT_ASYNC_SIZE 4096 // must be power of two
+#define EVENT_ARENA_SIZE (64 * KIBIBYTE)
+#define EVENT_ARENA_ALIGN 16
+#define CACHE_LINE 64
+#define PROFILE_SLOTS 256 // must be power of two
+#define PROFILE_BUFFER 8192
+
+// Subscriptions live in one pool and are chained per code by index,
+// sorted by priority. Indices stay valid when the pool grows.
 typedef struct {
     void *recipient;
-    on_event fn;
+    on_event fn; // 0 while waiting for deferred removal
+    u32 next;    // pool index + 1, 0 ends the list
+    u32 prev;
+    u16 code;
+    i16 priority;
+    u16 gen;
 } reg_event_t;
 
 typedef struct entry_event {
-    reg_event_t *events;
+    u32 head;    // pool index + 1
+    u32 pending; // queue position + 1 of the newest posted event
+    u8 coalesce; // event_coalesce_t
 } entry_event_t;
 
 typedef struct {
-    // lookup table
-    entry_event_t registered[MAX_MSG_CODE];
+    u16 code;
+    void *sender;
+    event_ctx_t ctx;
+    f64 time; // input timestamp for latency, 0 when untracked
+} queued_event_t;
+
+// Bounded MPSC ring (sequence per cell). A producer claims a slot with one
+// CAS on enqueue and publishes it by storing seq, the main thread is the
+// only consumer so dequeue needs no atomics of its own.
+typedef struct {
+    u32 seq;
+    queued_event_t ev;
+} async_cell_t;
+
+typedef struct {
+    ALIGN(CACHE_LINE) u32 enqueue;
+    ALIGN(CACHE_LINE) u32 dequeue;
+    ALIGN(CACHE_LINE) async_cell_t cells[EVENT_ASYNC_SIZE];
+} async_queue_t;
+
+typedef struct {
+    // lookup table, engine codes stay dense and hot, user pages are
+    // allocated on first register
+    entry_event_t engine[EVENT_PAGE_SIZE];
+    entry_event_t *pages[EVENT_PAGE_COUNT];
+
+    // subscription pool, free slots chained through next
+    reg_event_t *pool;
+    u32 free;
+
+    // removals requested while handlers were running
+    u32 *dead;
+    u32 dispatching;
+
+    // deferred events, head and tail only ever grow (wrap on u32)
+    queued_event_t queue[EVENT_QUEUE_SIZE];
+    u32 head;
+    u32 tail;
+
+    // flush scratch, queue contents in posting order
+    queued_event_t batch[EVENT_QUEUE_SIZE];
+
+    // events from other threads, drained by event_flush
+    async_queue_t async;
+
+    // posts folded into an already queued event
+    u64 coalesced;
+
+    // payload arenas, one takes writes while the other is dispatched
+    u8 *arena[2];
+    u64 arena_used[2];
+    u32 arena_cur;
 } event_system_t;
 
+// per handler timings, keyed by function pointer
+typedef struct {
+    on_event fn;
+    u16 last_code;
+    u64 calls;
+    u64 total; // platform ticks
+    u64 max;
+    u64 over_budget;
+} profile_slot_t;
+
+typedef struct {
+    b8 enabled;
+    f64 budget;       // seconds, 0 disables the over budget check
+    u64 budget_ticks;
+    u32 *code_counts; // dispatches per code, all 65536 codes
+    profile_slot_t slots[PROFILE_SLOTS];
+    u64 untracked; // calls that found no free slot
+} event_profile_t;
+
 static b8 initialized = false;
 static event_system_t g_ev = {0};
+static event_profile_t g_prof = {0};
+
+#define HANDLE_INDEX(h) ((h) & 0xFFFF)
+#define HANDLE_GEN(h) ((h) >> 16)
+
+// lookup only, 0 when the code's page was never allocated
+static INL entry_event_t *event_entry_find(u16 code)
+{
+    u16 page = code >> EVENT_PAGE_SHIFT;
+    if (page == 0) return &g_ev.engine[code];
+    if (g_ev.pages[page] == 0) return 0;
+    return &g_ev.pages[page][code & (EVENT_PAGE_SIZE - 1)];
+}
+
+static entry_event_t *event_entry_get(u16 code)
+{
+    u16 page = code >> EVENT_PAGE_SHIFT;
+    if (page != 0 && g_ev.pages[page] == 0)
+    {
+        g_ev.pages[page] =
+            mem_alloc(sizeof(entry_event_t) * EVENT_PAGE_SIZE, MEM_ENGINE);
+    }
+    return event_entry_find(code);
+}
+
+static void event_unlink(u32 index)
+{
+    reg_event_t *ev = &g_ev.pool[index];
+    entry_event_t *entry = event_entry_find(ev->code);
+
+    if (ev->prev)
+        g_ev.pool[ev->prev - 1].next = ev->next;
+    else
+        entry->head = ev->next;
+    if (ev->next) g_ev.pool[ev->next - 1].prev = ev->prev;
+
+    // bump generation so stale handles stop matching
+    ev->fn = 0;
+    ev->recipient = 0;
+    ev->gen++;
+    ev->prev = 0;
+    ev->next = g_ev.free;
+    g_ev.free = index + 1;
+}
 
 b8 event_sys_init(void)
 {
@@ -28,8 +164,25 @@ b8 event_sys_init(void)
         return false;
     }
     mem_zero(&g_ev, sizeof(g_ev));
+    g_ev.pool = da_create(reg_event_t);
+    g_ev.dead = da_create(u32);
+
+    for (u32 i = 0; i < EVENT_ASYNC_SIZE; ++i)
+    {
+        g_ev.async.cells[i].seq = i;
+    }
+
+    g_ev.arena[0] = mem_alloc(EVENT_ARENA_SIZE, MEM_ENGINE);
+    g_ev.arena[1] = mem_alloc(EVENT_ARENA_SIZE, MEM_ENGINE);
 
-    initialized = true;
+    // state-like engine events, handlers only care about the newest one
+    g_ev.engine[EV_MOUSE_MOVE].coalesce = EV_COALESCE_LATEST;
+    g_ev.engine[EV_RESIZED].coalesce = EV_COALESCE_LATEST;
+    g_ev.engine[EV_MOUSE_WHEEL].coalesce = EV_COALESCE_SUM;
+    g_ev.engine[EV_VISIBILITY_CHANGED].coalesce = EV_COALESCE_LATEST;
+    g_ev.engine[EV_FOCUS_CHANGED].coalesce = EV_COALESCE_LATEST;
+
+    __atomic_store_n(&initialized, true, __ATOMIC_RELEASE);
 
     LOGI("Event System Init");
     return true;
@@ -37,97 +190,542 @@ b8 event_sys_init(void)
 
 void event_sys_kill(void)
 {
-    for (u16 i = 0; i < MAX_MSG_CODE; ++i)
+    for (u32 i = 1; i < EVENT_PAGE_COUNT; ++i)
     {
-        if (g_ev.registered[i].events != 0)
+        if (g_ev.pages[i] != 0)
         {
-            da_destroy(g_ev.registered[i].events);
-            g_ev.registered[i].events = 0;
+            mem_free(g_ev.pages[i], sizeof(entry_event_t) * EVENT_PAGE_SIZE,
+                     MEM_ENGINE);
         }
     }
 
-    initialized = false;
+    mem_free(g_ev.arena[0], EVENT_ARENA_SIZE, MEM_ENGINE);
+    mem_free(g_ev.arena[1], EVENT_ARENA_SIZE, MEM_ENGINE);
+
+    da_destroy(g_ev.pool);
+    da_destroy(g_ev.dead);
+    mem_zero(&g_ev, sizeof(g_ev));
+
+    event_profile_enable(false, 0.0);
+
+    __atomic_store_n(&initialized, false, __ATOMIC_RELEASE);
     LOGI("Event System Kill");
 }
 
-b8 event_reg(u16 code, void *recipient, on_event on_event)
+event_handle_t event_reg(u16 code, void *recipient, on_event on_event)
 {
-    if (initialized == false)
+    return event_reg_prio(code, recipient, on_event, EVENT_PRIORITY_DEFAULT);
+}
+
+static event_handle_t event_reg_at(u16 code, void *recipient,
+                                   on_event on_event, i16 priority);
+
+event_handle_t event_reg_prio(u16 code, void *recipient, on_event on_event,
+                              i16 priority)
+{
+    if (priority >= EVENT_PRIORITY_SYSTEM)
     {
-        return false;
+        LOGW("Event priority %d is reserved, code %u gets %d", priority, code,
+             EVENT_PRIORITY_SYSTEM - 1);
+        priority = EVENT_PRIORITY_SYSTEM - 1;
     }
-    if (g_ev.registered[code].events == 0)
+    return event_reg_at(code, recipient, on_event, priority);
+}
+
+event_handle_t event_reg_system(u16 code, void *recipient, on_event on_event)
+{
+    return event_reg_at(code, recipient, on_event, EVENT_PRIORITY_SYSTEM);
+}
+
+static event_handle_t event_reg_at(u16 code, void *recipient,
+                                   on_event on_event, i16 priority)
+{
+    if (initialized == false || on_event == 0)
     {
-        g_ev.registered[code].events = da_create(reg_event_t);
+        return 0;
     }
 
-    u64 reg_count = da_length(g_ev.registered[code].events);
-    for (u64 i = 0; i < reg_count; ++i)
+    u32 index;
+    if (g_ev.free)
     {
-        if (g_ev.registered[code].events[i].recipient == recipient)
+        index = g_ev.free - 1;
+        g_ev.free = g_ev.pool[index].next;
+    }
+    else
+    {
+        index = (u32)da_length(g_ev.pool);
+        if (index >= 0xFFFF)
         {
-            // TODO: maybe gives warning ?
-            return false;
+            LOGE("Event subscription pool exhausted");
+            return 0;
         }
+        reg_event_t blank = {0};
+        da_push(g_ev.pool, blank);
     }
 
-    reg_event_t ev = {.recipient = recipient, .fn = on_event};
-    da_push(g_ev.registered[code].events, ev);
+    reg_event_t *ev = &g_ev.pool[index];
+    ev->recipient = recipient;
+    ev->fn = on_event;
+    ev->code = code;
+    ev->priority = priority;
 
+    // keep list sorted, higher priority first, ties in registration order
+    entry_event_t *entry = event_entry_get(code);
+    u32 prev = 0;
+    u32 next = entry->head;
+    while (next && g_ev.pool[next - 1].priority >= priority)
+    {
+        prev = next;
+        next = g_ev.pool[next - 1].next;
+    }
+
+    ev->prev = prev;
+    ev->next = next;
+    if (prev)
+        g_ev.pool[prev - 1].next = index + 1;
+    else
+        entry->head = index + 1;
+    if (next) g_ev.pool[next - 1].prev = index + 1;
+
+    return ((u32)ev->gen << 16) | (index + 1);
+}
+
+b8 event_unreg(event_handle_t handle)
+{
+    if (initialized == false || HANDLE_INDEX(handle) == 0)
+    {
+        return false;
+    }
+
+    u32 index = HANDLE_INDEX(handle) - 1;
+    if (index >= da_length(g_ev.pool))
+    {
+        return false;
+    }
+
+    reg_event_t *ev = &g_ev.pool[index];
+    if (ev->gen != HANDLE_GEN(handle) || ev->fn == 0)
+    {
+        // stale handle or already waiting for removal
+        return false;
+    }
+
+    if (g_ev.dispatching)
+    {
+        // a handler list is being walked, unlink once it is done
+        ev->fn = 0;
+        da_push(g_ev.dead, index);
+        return true;
+    }
+
+    event_unlink(index);
     return true;
 }
 
-b8 event_unreg(u16 code, void *recipient, on_event on_event)
+static void event_dispatch_end(void)
+{
+    if (--g_ev.dispatching != 0) return;
+
+    u64 dead_count = da_length(g_ev.dead);
+    for (u64 i = 0; i < dead_count; ++i)
+    {
+        event_unlink(g_ev.dead[i]);
+    }
+    da_clear(g_ev.dead);
+}
+
+static profile_slot_t *event_profile_slot(on_event fn)
+{
+    u32 hash = (u32)(((uptr)fn >> 4) * 0x9E3779B97F4A7C15ULL >> 32);
+
+    for (u32 i = 0; i < PROFILE_SLOTS; ++i)
+    {
+        profile_slot_t *slot = &g_prof.slots[(hash + i) & (PROFILE_SLOTS - 1)];
+        if (slot->fn == fn) return slot;
+        if (slot->fn == 0)
+        {
+            slot->fn = fn;
+            return slot;
+        }
+    }
+
+    return 0;
+}
+
+static b8 event_profile_call(on_event fn, u16 code, void *sender,
+                             void *recipient, event_ctx_t ctx)
+{
+    u64 start = platform_get_ticks();
+    b8 handled = fn(code, sender, recipient, ctx);
+    u64 elapsed = platform_get_ticks() - start;
+
+    profile_slot_t *slot = event_profile_slot(fn);
+    if (slot == 0)
+    {
+        g_prof.untracked++;
+        return handled;
+    }
+
+    slot->last_code = code;
+    slot->calls++;
+    slot->total += elapsed;
+    if (elapsed > slot->max) slot->max = elapsed;
+    if (g_prof.budget_ticks && elapsed > g_prof.budget_ticks)
+    {
+        slot->over_budget++;
+    }
+
+    return handled;
+}
+
+static b8 event_dispatch(u32 head, u16 code, void *sender, event_ctx_t ctx)
+{
+    b8 handled = false;
+    g_ev.dispatching++;
+
+    // the pool may grow inside a handler, so never hold a node pointer
+    // across the call
+    for (u32 n = head; n != 0; n = g_ev.pool[n - 1].next)
+    {
+        on_event fn = g_ev.pool[n - 1].fn;
+        if (fn == 0) continue;
+
+        void *recipient = g_ev.pool[n - 1].recipient;
+        b8 result = g_prof.enabled
+                        ? event_profile_call(fn, code, sender, recipient, ctx)
+                        : fn(code, sender, recipient, ctx);
+        if (result)
+        {
+            // has been handle, not sending to other recipient
+            handled = true;
+            break;
+        }
+    }
+
+    event_dispatch_end();
+    return handled;
+}
+
+b8 event_emit(u16 code, void *sender, event_ctx_t ctx)
 {
     if (initialized == false)
     {
         return false;
     }
-    if (g_ev.registered[code].events == 0)
+    if (g_prof.enabled) g_prof.code_counts[code]++;
+
+    entry_event_t *entry = event_entry_find(code);
+    if (entry == 0 || entry->head == 0)
     {
         // TODO: maybe gives warning ?
         return false;
     }
 
-    u64 reg_count = da_length(g_ev.registered[code].events);
-    for (u64 i = 0; i < reg_count; ++i)
+    return event_dispatch(entry->head, code, sender, ctx);
+}
+
+b8 event_post(u16 code, void *sender, event_ctx_t ctx)
+{
+    return event_post_at(code, sender, ctx, 0.0);
+}
+
+b8 event_post_at(u16 code, void *sender, event_ctx_t ctx, f64 time)
+{
+    if (initialized == false)
     {
-        reg_event_t ev = g_ev.registered[code].events[i];
-        if (ev.recipient == recipient && ev.fn == on_event)
+        return false;
+    }
+    if (g_ev.tail - g_ev.head == EVENT_QUEUE_SIZE)
+    {
+        // never drop input, fall back to dispatch right away
+        LOGW("Event queue full, code %u dispatched immediately", code);
+        b8 result = event_emit(code, sender, ctx);
+        latency_dispatched(time, platform_get_time());
+        return result;
+    }
+
+    entry_event_t *entry = event_entry_find(code);
+    if (entry && entry->coalesce != EV_COALESCE_NONE && entry->pending &&
+        entry->pending - 1 - g_ev.head < g_ev.tail - g_ev.head)
+    {
+        // an event of this code is still waiting, fold into it
+        queued_event_t *q =
+            &g_ev.queue[(entry->pending - 1) & (EVENT_QUEUE_SIZE - 1)];
+        AM2_ASSERT(q->code == code);
+
+        if (entry->coalesce == EV_COALESCE_SUM)
         {
-            // found, remove it
-            reg_event_t pop_ev;
-            da_pop_at(g_ev.registered[code].events, i, &pop_ev);
-            return true;
+            // unsigned add wraps like i32 without the overflow UB
+            for (u32 i = 0; i < 4; ++i)
+            {
+                q->ctx.data.u32[i] += ctx.data.u32[i];
+            }
         }
+        else
+        {
+            q->ctx = ctx;
+        }
+        q->sender = sender;
+        // latency counts from the oldest input folded in
+        if (q->time <= 0.0) q->time = time;
+
+        g_ev.coalesced++;
+        return true;
     }
 
-    // not found
-    return false;
+    queued_event_t *q = &g_ev.queue[g_ev.tail & (EVENT_QUEUE_SIZE - 1)];
+    q->code = code;
+    q->sender = sender;
+    q->ctx = ctx;
+    q->time = time;
+    g_ev.tail++;
+    if (entry) entry->pending = g_ev.tail;
+
+    return true;
 }
 
-b8 event_emit(u16 code, void *sender, event_ctx_t ctx)
+void event_set_coalesce(u16 code, event_coalesce_t policy)
 {
     if (initialized == false)
+    {
+        return;
+    }
+
+    event_entry_get(code)->coalesce = (u8)policy;
+}
+
+u64 event_coalesced_count(void) { return g_ev.coalesced; }
+
+void *event_payload_alloc(u64 size)
+{
+    if (initialized == false)
+    {
+        return 0;
+    }
+
+    u32 cur = g_ev.arena_cur;
+    u64 offset = (g_ev.arena_used[cur] + EVENT_ARENA_ALIGN - 1) &
+                 ~(u64)(EVENT_ARENA_ALIGN - 1);
+
+    if (offset + size > EVENT_ARENA_SIZE)
+    {
+        LOGW("Event payload arena full, %llu bytes refused", size);
+        return 0;
+    }
+
+    g_ev.arena_used[cur] = offset + size;
+    return g_ev.arena[cur] + offset;
+}
+
+b8 event_post_async(u16 code, void *sender, event_ctx_t ctx)
+{
+    if (__atomic_load_n(&initialized, __ATOMIC_ACQUIRE) == false)
     {
         return false;
     }
-    if (g_ev.registered[code].events == 0)
+
+    async_queue_t *q = &g_ev.async;
+    async_cell_t *cell;
+    u32 pos = __atomic_load_n(&q->enqueue, __ATOMIC_RELAXED);
+
+    for (;;)
     {
-        // TODO: maybe gives warning ?
+        cell = &q->cells[pos & (EVENT_ASYNC_SIZE - 1)];
+        u32 seq = __atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE);
+        i32 diff = (i32)(seq - pos);
+
+        if (diff == 0)
+        {
+            // slot is free for this lap, try to claim it
+            if (__atomic_compare_exchange_n(&q->enqueue, &pos, pos + 1, true,
+                                            __ATOMIC_RELAXED,
+                                            __ATOMIC_RELAXED))
+            {
+                break;
+            }
+        }
+        else if (diff < 0)
+        {
+            // consumer is a full lap behind
+            return false;
+        }
+        else
+        {
+            pos = __atomic_load_n(&q->enqueue, __ATOMIC_RELAXED);
+        }
+    }
+
+    cell->ev.code = code;
+    cell->ev.sender = sender;
+    cell->ev.ctx = ctx;
+    cell->ev.time = 0.0;
+    __atomic_store_n(&cell->seq, pos + 1, __ATOMIC_RELEASE);
+
+    return true;
+}
+
+static b8 event_async_pop(queued_event_t *out)
+{
+    async_queue_t *q = &g_ev.async;
+    async_cell_t *cell = &q->cells[q->dequeue & (EVENT_ASYNC_SIZE - 1)];
+    u32 seq = __atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE);
+
+    if ((i32)(seq - (q->dequeue + 1)) < 0)
+    {
+        // next slot not published yet
         return false;
     }
 
-    u64 reg_count = da_length(g_ev.registered[code].events);
-    for (u64 i = 0; i < reg_count; ++i)
+    *out = cell->ev;
+    __atomic_store_n(&cell->seq, q->dequeue + EVENT_ASYNC_SIZE,
+                     __ATOMIC_RELEASE);
+    q->dequeue++;
+
+    return true;
+}
+
+void event_flush(void)
+{
+    if (initialized == false)
     {
-        reg_event_t ev = g_ev.registered[code].events[i];
-        if (ev.fn(code, sender, ev.recipient, ctx))
+        return;
+    }
+
+    // Move the queue into the batch in posting order. Sorting by code
+    // would reorder paired input (press, release, press of one key) and
+    // window transitions; state-like codes coalesce into one slot instead.
+    // Events posted by handlers below land in the ring for next frame.
+    u32 count = 0;
+    while (g_ev.head != g_ev.tail)
+    {
+        g_ev.batch[count++] = g_ev.queue[g_ev.head & (EVENT_QUEUE_SIZE - 1)];
+        g_ev.head++;
+    }
+
+    // worker events fill what is left, the rest waits for next frame
+    while (count < EVENT_QUEUE_SIZE && event_async_pop(&g_ev.batch[count]))
+    {
+        count++;
+    }
+
+    // everything in the batch wrote its payload into the current arena,
+    // new posts (handlers included) go to the other one from here
+    u32 arena_done = g_ev.arena_cur;
+    g_ev.arena_cur ^= 1;
+
+    // The handler list is read again for every event, so a handler
+    // (un)registered mid batch applies to the rest of it. The batch
+    // counts as one dispatch, removals are swept once at its end.
+    g_ev.dispatching++;
+
+    for (u32 i = 0; i < count; ++i)
+    {
+        u16 code = g_ev.batch[i].code;
+        if (g_prof.enabled) g_prof.code_counts[code]++;
+
+        entry_event_t *entry = event_entry_find(code);
+        if (entry && entry->head)
         {
-            // has been handle, not sending to other recipient
-            return true;
+            event_dispatch(entry->head, code, g_ev.batch[i].sender,
+                           g_ev.batch[i].ctx);
+        }
+        if (g_ev.batch[i].time > 0.0)
+        {
+            latency_dispatched(g_ev.batch[i].time, platform_get_time());
+        }
+    }
+
+    event_dispatch_end();
+    g_ev.arena_used[arena_done] = 0;
+}
+
+void event_profile_enable(b8 enable, f64 budget_ms)
+{
+    g_prof.budget = budget_ms / 1000.0;
+    g_prof.budget_ticks =
+        (u64)(g_prof.budget * (f64)platform_get_tick_frequency());
+    if (enable == g_prof.enabled) return;
+
+    if (enable)
+    {
+        g_prof.code_counts = mem_alloc(sizeof(u32) * 0x10000, MEM_ENGINE);
+    }
+    else
+    {
+        mem_free(g_prof.code_counts, sizeof(u32) * 0x10000, MEM_ENGINE);
+        g_prof.code_counts = 0;
+    }
+    g_prof.enabled = enable;
+    event_profile_reset();
+}
+
+void event_profile_reset(void)
+{
+    if (g_prof.code_counts)
+    {
+        mem_zero(g_prof.code_counts, sizeof(u32) * 0x10000);
+    }
+    mem_zero(g_prof.slots, sizeof(g_prof.slots));
+    g_prof.untracked = 0;
+}
+
+char *get_event_profile(void)
+{
+    static char buffer[PROFILE_BUFFER];
+    u64 offset = 0;
+
+    if (!g_prof.enabled)
+    {
+        snprintf(buffer, sizeof(buffer), "Event Profile: disabled\n");
+        return buffer;
+    }
+
+    offset += (u64)snprintf(buffer + offset, sizeof(buffer) - offset,
+                            "Event Profile (budget %.3f ms):\n",
+                            g_prof.budget * 1000.0);
+
+    for (u32 code = 0; code < 0x10000; ++code)
+    {
+        u32 count = g_prof.code_counts[code];
+        if (count == 0) continue;
+
+        i32 length = snprintf(buffer + offset, sizeof(buffer) - offset,
+                              "--> code %u: emitted %u\n", code, count);
+
+        if (length > 0 && (offset + (u32)length < PROFILE_BUFFER))
+        {
+            offset += (u32)length;
+        }
+        else
+            return buffer;
+    }
+
+    for (u32 i = 0; i < PROFILE_SLOTS; ++i)
+    {
+        profile_slot_t *slot = &g_prof.slots[i];
+        if (slot->fn == 0 || slot->calls == 0) continue;
+
+        i32 length = snprintf(
+            buffer + offset, sizeof(buffer) - offset,
+            "--> handler 0x%llx (code %u): calls %llu, total %.4f ms, "
+            "max %.4f ms%s\n",
+            (u64)(uptr)slot->fn, slot->last_code, slot->calls,
+            (f64)platform_ticks_to_ns(slot->total) * 1e-6,
+            (f64)platform_ticks_to_ns(slot->max) * 1e-6,
+            slot->over_budget ? ", OVER BUDGET" : "");
+
+        if (length > 0 && (offset + (u32)length < PROFILE_BUFFER))
+        {
+            offset += (u32)length;
         }
+        else
+            return buffer;
     }
 
-    return false;
+    if (g_prof.untracked)
+    {
+        snprintf(buffer + offset, sizeof(buffer) - offset,
+                 "--> untracked handler calls: %llu\n", g_prof.untracked);
+    }
+    return buffer;
 }
@@ -24,10 +24,32 @@ typedef struct {
     } data;
 } event_ctx_t;
 
+// ctx that points into payload memory from event_payload_alloc
+static INL event_ctx_t event_ctx_payload(const void *data, u64 size)
+{
+    event_ctx_t ctx;
+    ctx.data.u64[0] = (u64)(uptr)data;
+    ctx.data.u64[1] = size;
+    return ctx;
+}
+
+#define EVENT_PAYLOAD(ctx) ((const void *)(uptr)(ctx).data.u64[0])
+#define EVENT_PAYLOAD_SIZE(ctx) ((ctx).data.u64[1])
+
 // return true if handled
 typedef b8 (*on_event)(u16 code, void *sender, void *recipient,
                        event_ctx_t data);
 
+// subscription returned by event_reg, 0 is never a valid handle
+typedef u32 event_handle_t;
+
+// handlers with higher priority run first, equal ones in register order
+#define EVENT_PRIORITY_DEFAULT 0
+// reserved for engine observers that never handle, e.g. coroutine wakeups,
+// so no game handler can stop dispatch before they ran. Only
+// event_reg_system gets it, event_reg_prio clamps below.
+#define EVENT_PRIORITY_SYSTEM 0x7FFF
+
 // application & user code use beyond 255
 typedef enum {
     EV_APP_QUIT = 0x01,
@@ -38,18 +60,78 @@ typedef enum {
     EV_MOUSE_MOVE = 0x06,
     EV_MOUSE_WHEEL = 0x07,
     EV_RESIZED = 0x08,
+    // state carried in ctx.data.u8[0], only the newest of a frame is kept
+    EV_VISIBILITY_CHANGED = 0x09, // 1 mapped, 0 iconified or hidden
+    EV_FOCUS_CHANGED = 0x0A,      // 1 focused, 0 not
+    EV_FILE_READ = 0x0B,          // async read finished, see aio.h
 
     MAX_EVENT_CODE = 0xFF
 } event_code_t;
 
+// what event_post does when the code already has an event queued
+typedef enum {
+    EV_COALESCE_NONE,   // keep every event
+    EV_COALESCE_LATEST, // replace the queued ctx with the newest one
+    EV_COALESCE_SUM,    // add the i32 lanes into the queued ctx
+} event_coalesce_t;
+
 b8 event_sys_init(void);
 
 void event_sys_kill(void);
 
-AM2_API b8 event_reg(u16 code, void *recipient, on_event on_event);
+AM2_API event_handle_t event_reg(u16 code, void *recipient,
+                                 on_event on_event);
+
+// priorities at or above EVENT_PRIORITY_SYSTEM are lowered to just below
+AM2_API event_handle_t event_reg_prio(u16 code, void *recipient,
+                                      on_event on_event, i16 priority);
 
-AM2_API b8 event_unreg(u16 code, void *recipient, on_event on_event);
+// engine observers only, runs ahead of every event_reg_prio handler
+event_handle_t event_reg_system(u16 code, void *recipient,
+                                on_event on_event);
+
+// safe inside a handler, the removal waits until dispatch returns
+AM2_API b8 event_unreg(event_handle_t handle);
 
 AM2_API b8 event_emit(u16 code, void *sender, event_ctx_t ctx);
 
+// queue the event, dispatched on the next event_flush
+AM2_API b8 event_post(u16 code, void *sender, event_ctx_t ctx);
+
+// event_post carrying the input timestamp it came from, feeds the
+// dispatch and consume latency stages
+AM2_API b8 event_post_at(u16 code, void *sender, event_ctx_t ctx, f64 time);
+
+// policy applies to event_post only, event_emit always dispatches
+AM2_API void event_set_coalesce(u16 code, event_coalesce_t policy);
+
+// total posts merged into an already queued event
+AM2_API u64 event_coalesced_count(void);
+
+// Per frame scratch for payloads bigger than event_ctx_t, main thread
+// only. Write it once, post event_ctx_payload(ptr, size), handlers read
+// it in place. Recycled after the flush that dispatches the event, so
+// handlers must copy anything they keep. Returns 0 when the arena is full.
+AM2_API void *event_payload_alloc(u64 size);
+
+// Thread safe and lock free, callable from any thread. Returns false
+// when the async queue is full, the event is not queued then.
+AM2_API b8 event_post_async(u16 code, void *sender, event_ctx_t ctx);
+
+// Dispatch profiling, off by default. Counts dispatches per code and
+// times every handler call; calls longer than budget_ms are flagged
+// (0 turns the check off).
+AM2_API void event_profile_enable(b8 enable, f64 budget_ms);
+
+AM2_API void event_profile_reset(void);
+
+AM2_API char *get_event_profile(void);
+
+// Dispatch every queued event in posting order, then the worker events
+// (each worker's in its own order). A coalesced code keeps the slot of
+// its first post with the newest ctx. Each event sees the handlers
+// registered at the time it is dispatched, including ones a handler for
+// an earlier event of the batch added or removed.
+void event_flush(void);
+
 #endif // EVENT_H
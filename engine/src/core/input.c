@@ -1,30 +1,62 @@
 #include "input.h"
 #include "event.h"
 #include "memory.h"
+#include "trace.h"
+#include "action.h"
 
-#define KEYNAME(k) [KEY_##k] = #k
+#if defined(__SSE2__)
+#    include <emmintrin.h>
+#endif
 
-typedef struct {
-    b8 keys[KEY_COUNT];
-    u8 mods;
-} kbd_state;
+#define KEYNAME(k) [KEY_##k] = #k
+#define INPUT_EVENT_MAX 256
 
 typedef struct {
     i16 x, y;
-    i8 mouse_wheel_delta;
-    u8 buttons[MB_COUNT];
 } mouse_state;
 
 typedef struct {
-    kbd_state kbd_current;
-    kbd_state kbd_prev;
+    // keys and mouse buttons, one bit each (see input_mask_key/button)
+    input_mask_t down;     // live, written by the platform layer
+    input_mask_t snapshot; // down at the last input_sys_update
+    input_mask_t prev;     // snapshot before that, the previous frame
+    input_mask_t pressed;  // went down between the last two updates
+    input_mask_t released; // went up between the last two updates
+    u8 mods;               // as the platform reported, only caps is used
+
     mouse_state mouse_current;
+    mouse_state mouse_snapshot;
     mouse_state mouse_prev;
+
+    // raw motion summed by the platform, published per frame
+    f64 raw_accum[2];
+    f64 raw_frame[2];
+
+    // transitions, the platform writes one buffer while game code reads
+    // the other, swapped by input_sys_update
+    input_event_t events[2][INPUT_EVENT_MAX];
+    u32 event_count[2];
+    u32 event_write;
+    u64 events_dropped;
 } input_system_t;
 
 static b8 initialized = false;
 static input_system_t g_input = {0};
 
+static INL b8 mask_test(const input_mask_t *m, u32 bit)
+{
+    return (m->bits[bit >> 6] >> (bit & 63)) & 1;
+}
+
+static INL void mask_write(input_mask_t *m, u32 bit, b8 value)
+{
+    u64 flag = 1ULL << (bit & 63);
+    if (value)
+        m->bits[bit >> 6] |= flag;
+    else
+        m->bits[bit >> 6] &= ~flag;
+}
+
 void input_sys_init(void)
 {
     initialized = true;
@@ -37,6 +69,19 @@ void input_sys_kill(void)
     LOGI("Input System Kill");
 }
 
+// Held modifiers of the snapshot. The platform's mods lag one key
+// event behind, so only the caps lock state, which has no key, is kept.
+static u8 input_snapshot_mods(void)
+{
+    const input_mask_t *m = &g_input.snapshot;
+    u8 mods = g_input.mods & MOD_CAPS;
+    if (mask_test(m, KEY_SHIFT)) mods |= MOD_SHIFT;
+    if (mask_test(m, KEY_CTRL)) mods |= MOD_CTRL;
+    if (mask_test(m, KEY_ALT)) mods |= MOD_ALT;
+    if (mask_test(m, KEY_SUPER)) mods |= MOD_SUPER;
+    return mods;
+}
+
 void input_sys_update(f64 delta)
 {
     (void)delta;
@@ -45,38 +90,120 @@ void input_sys_update(f64 delta)
         return;
     }
 
-    mem_copy(&g_input.kbd_prev, &g_input.kbd_current, sizeof(kbd_state));
-    mem_copy(&g_input.mouse_prev, &g_input.mouse_current, sizeof(mouse_state));
+    // edges against the last snapshot, then the snapshot moves to prev
+#if defined(__SSE2__)
+    __m128i cur = _mm_load_si128((const __m128i *)g_input.down.bits);
+    __m128i old = _mm_load_si128((const __m128i *)g_input.snapshot.bits);
+
+    _mm_store_si128((__m128i *)g_input.pressed.bits,
+                    _mm_andnot_si128(old, cur));
+    _mm_store_si128((__m128i *)g_input.released.bits,
+                    _mm_andnot_si128(cur, old));
+    _mm_store_si128((__m128i *)g_input.prev.bits, old);
+    _mm_store_si128((__m128i *)g_input.snapshot.bits, cur);
+#else
+    for (u32 i = 0; i < 2; ++i)
+    {
+        u64 cur = g_input.down.bits[i];
+        u64 old = g_input.snapshot.bits[i];
+
+        g_input.pressed.bits[i] = cur & ~old;
+        g_input.released.bits[i] = old & ~cur;
+        g_input.prev.bits[i] = old;
+        g_input.snapshot.bits[i] = cur;
+    }
+#endif
+
+    g_input.mouse_prev = g_input.mouse_snapshot;
+    g_input.mouse_snapshot = g_input.mouse_current;
+
+    g_input.raw_frame[0] = g_input.raw_accum[0];
+    g_input.raw_frame[1] = g_input.raw_accum[1];
+    g_input.raw_accum[0] = g_input.raw_accum[1] = 0.0;
+
+    // every action binding in one sweep over this frame's state
+    action_sys_update(&g_input.snapshot, input_snapshot_mods());
+
+    g_input.event_write ^= 1;
+    g_input.event_count[g_input.event_write] = 0;
 }
 
-void input_process_key(keys key, b8 pressed)
+static void input_push_event(u16 code, u16 value, f64 time)
 {
-    if (g_input.kbd_current.keys[key] != pressed)
+    u32 w = g_input.event_write;
+    if (g_input.event_count[w] == INPUT_EVENT_MAX)
     {
-        g_input.kbd_current.keys[key] = pressed;
+        g_input.events_dropped++;
+        return;
+    }
+
+    input_event_t *ev = &g_input.events[w][g_input.event_count[w]++];
+    ev->time = time;
+    ev->code = code;
+    ev->value = value;
+}
+
+void input_process_key(keys key, b8 pressed, f64 time)
+{
+    event_ctx_t rec = {0};
+    rec.data.u16[0] = (u16)key;
+    rec.data.u8[2] = pressed;
+    trace_capture_at(TRACE_KEY, 0, rec, time);
+
+    if (mask_test(&g_input.down, (u32)key) != pressed)
+    {
+        mask_write(&g_input.down, (u32)key, pressed);
+
+        u16 code = pressed ? EV_KEY_PRESSED : EV_KEY_RELEASED;
+        input_push_event(code, (u16)key, time);
 
         event_ctx_t evc;
         evc.data.u16[0] = (u16)key;
-        event_emit(pressed ? EV_KEY_PRESSED : EV_KEY_RELEASED, 0, evc);
+        event_post_at(code, 0, evc, time);
     }
 }
 
-void input_process_mods(u8 mods) { g_input.kbd_current.mods = mods; }
+void input_process_mods(u8 mods)
+{
+    if (g_input.mods != mods)
+    {
+        event_ctx_t rec = {0};
+        rec.data.u8[0] = mods;
+        trace_capture(TRACE_MODS, 0, rec);
+    }
+
+    g_input.mods = mods;
+}
 
-void input_process_mouse_button(mouse_buttons button, b8 pressed)
+void input_process_mouse_button(mouse_buttons button, b8 pressed,
+                                f64 time)
 {
-    if (g_input.mouse_current.buttons[button] != pressed)
+    event_ctx_t rec = {0};
+    rec.data.u16[0] = (u16)button;
+    rec.data.u8[2] = pressed;
+    trace_capture_at(TRACE_BUTTON, 0, rec, time);
+
+    u32 bit = INPUT_BUTTON_BIT(button);
+    if (mask_test(&g_input.down, bit) != pressed)
     {
-        g_input.mouse_current.buttons[button] = pressed;
+        mask_write(&g_input.down, bit, pressed);
+
+        u16 code = pressed ? EV_MB_PRESSED : EV_MB_RELEASED;
+        input_push_event(code, (u16)button, time);
 
         event_ctx_t evc;
         evc.data.u16[0] = (u16)button;
-        event_emit(pressed ? EV_MB_PRESSED : EV_MB_RELEASED, 0, evc);
+        event_post_at(code, 0, evc, time);
     }
 }
 
 void input_process_mouse_move(i16 x, i16 y)
 {
+    event_ctx_t rec = {0};
+    rec.data.i16[0] = x;
+    rec.data.i16[1] = y;
+    trace_capture(TRACE_MOVE, 0, rec);
+
     if (g_input.mouse_current.x != x || g_input.mouse_current.y != y)
     {
         g_input.mouse_current.x = x;
@@ -85,15 +212,30 @@ void input_process_mouse_move(i16 x, i16 y)
         event_ctx_t evc;
         evc.data.u16[0] = (u16)x;
         evc.data.u16[1] = (u16)y;
-        event_emit(EV_MOUSE_MOVE, 0, evc);
+        event_post(EV_MOUSE_MOVE, 0, evc);
     }
 }
 
 void input_process_mouse_wheel(i8 z_delta)
 {
-    event_ctx_t evc;
-    evc.data.u8[0] = (u8)z_delta;
-    event_emit(EV_MOUSE_WHEEL, 0, evc);
+    // i32 lane so queued wheel events can be summed
+    event_ctx_t evc = {0};
+    evc.data.i32[0] = z_delta;
+    trace_capture(TRACE_WHEEL, 0, evc);
+
+    event_post(EV_MOUSE_WHEEL, 0, evc);
+}
+
+void input_process_mouse_raw(f64 dx, f64 dy)
+{
+    event_ctx_t rec = {0};
+    rec.data.f64[0] = dx;
+    rec.data.f64[1] = dy;
+    trace_capture(TRACE_RAW, 0, rec);
+
+    // no event on purpose, high rate mice would flood every handler
+    g_input.raw_accum[0] += dx;
+    g_input.raw_accum[1] += dy;
 }
 
 b8 input_keydown(keys key)
@@ -103,7 +245,7 @@ b8 input_keydown(keys key)
         return false;
     }
 
-    return g_input.kbd_current.keys[key] == true;
+    return mask_test(&g_input.down, (u32)key);
 }
 
 b8 input_keyup(keys key)
@@ -113,7 +255,7 @@ b8 input_keyup(keys key)
         return true;
     }
 
-    return g_input.kbd_current.keys[key] == false;
+    return !mask_test(&g_input.down, (u32)key);
 }
 
 b8 input_was_keydown(keys key)
@@ -123,7 +265,7 @@ b8 input_was_keydown(keys key)
         return false;
     }
 
-    return g_input.kbd_prev.keys[key] == true;
+    return mask_test(&g_input.prev, (u32)key);
 }
 
 b8 input_was_keyup(keys key)
@@ -133,7 +275,27 @@ b8 input_was_keyup(keys key)
         return true;
     }
 
-    return g_input.kbd_prev.keys[key] == false;
+    return !mask_test(&g_input.prev, (u32)key);
+}
+
+b8 input_key_pressed(keys key)
+{
+    if (!initialized)
+    {
+        return false;
+    }
+
+    return mask_test(&g_input.pressed, (u32)key);
+}
+
+b8 input_key_released(keys key)
+{
+    if (!initialized)
+    {
+        return false;
+    }
+
+    return mask_test(&g_input.released, (u32)key);
 }
 
 b8 input_mouse_button_down(mouse_buttons button)
@@ -143,7 +305,7 @@ b8 input_mouse_button_down(mouse_buttons button)
         return false;
     }
 
-    return g_input.mouse_current.buttons[button] == true;
+    return mask_test(&g_input.down, INPUT_BUTTON_BIT(button));
 }
 
 b8 input_mouse_button_up(mouse_buttons button)
@@ -153,7 +315,7 @@ b8 input_mouse_button_up(mouse_buttons button)
         return true;
     }
 
-    return g_input.mouse_current.buttons[button] == false;
+    return !mask_test(&g_input.down, INPUT_BUTTON_BIT(button));
 }
 
 b8 input_mouse_was_button_down(mouse_buttons button)
@@ -163,7 +325,7 @@ b8 input_mouse_was_button_down(mouse_buttons button)
         return false;
     }
 
-    return g_input.mouse_prev.buttons[button] == true;
+    return mask_test(&g_input.prev, INPUT_BUTTON_BIT(button));
 }
 
 b8 input_mouse_was_button_up(mouse_buttons button)
@@ -173,7 +335,60 @@ b8 input_mouse_was_button_up(mouse_buttons button)
         return true;
     }
 
-    return g_input.mouse_prev.buttons[button] == false;
+    return !mask_test(&g_input.prev, INPUT_BUTTON_BIT(button));
+}
+
+b8 input_pressed_any(input_mask_t mask)
+{
+    if (!initialized)
+    {
+        return false;
+    }
+
+    return ((g_input.pressed.bits[0] & mask.bits[0]) |
+            (g_input.pressed.bits[1] & mask.bits[1])) != 0;
+}
+
+b8 input_released_any(input_mask_t mask)
+{
+    if (!initialized)
+    {
+        return false;
+    }
+
+    return ((g_input.released.bits[0] & mask.bits[0]) |
+            (g_input.released.bits[1] & mask.bits[1])) != 0;
+}
+
+b8 input_chord_down(input_mask_t mask)
+{
+    if (!initialized)
+    {
+        return false;
+    }
+
+    // the snapshot, so down and pressed agree with the edges and actions
+    return (g_input.snapshot.bits[0] & mask.bits[0]) == mask.bits[0] &&
+           (g_input.snapshot.bits[1] & mask.bits[1]) == mask.bits[1];
+}
+
+b8 input_chord_pressed(input_mask_t mask)
+{
+    // whole chord held and the last piece landed this frame
+    return input_chord_down(mask) && input_pressed_any(mask);
+}
+
+u32 input_get_events(const input_event_t **out)
+{
+    if (!initialized)
+    {
+        *out = 0;
+        return 0;
+    }
+
+    u32 r = g_input.event_write ^ 1;
+    *out = g_input.events[r];
+    return g_input.event_count[r];
 }
 
 void input_get_mouse_pos(i32 *x, i32 *y)
@@ -202,6 +417,19 @@ void input_get_mouse_prev_pos(i32 *x, i32 *y)
     *y = g_input.mouse_prev.y;
 }
 
+void input_get_mouse_delta(f64 *dx, f64 *dy)
+{
+    if (!initialized)
+    {
+        *dx = 0.0;
+        *dy = 0.0;
+        return;
+    }
+
+    *dx = g_input.raw_frame[0];
+    *dy = g_input.raw_frame[1];
+}
+
 // clang-format off
 static const char* key_names[KEY_COUNT] = {
 	// letters
@@ -88,18 +88,57 @@ typedef enum {
     MOD_CAPS = 1 << 4,
 } key_mod;
 
+// Keys and mouse buttons share one 128 bit mask, keys first then the
+// buttons, so chords can mix both.
+typedef struct {
+    ALIGN(16) u64 bits[2];
+} input_mask_t;
+
+#define INPUT_BUTTON_BIT(button) ((u32)KEY_COUNT + (u32)(button))
+
+STATIC_ASSERT(KEY_COUNT + MB_COUNT <= 128, input_fits_in_mask);
+
+static INL input_mask_t input_mask_add(input_mask_t mask, u32 bit)
+{
+    mask.bits[bit >> 6] |= 1ULL << (bit & 63);
+    return mask;
+}
+
+static INL input_mask_t input_mask_key(keys key)
+{
+    input_mask_t mask = {{0, 0}};
+    return input_mask_add(mask, (u32)key);
+}
+
+static INL input_mask_t input_mask_button(mouse_buttons button)
+{
+    input_mask_t mask = {{0, 0}};
+    return input_mask_add(mask, INPUT_BUTTON_BIT(button));
+}
+
+// one key or button transition, times share the platform_get_time base
+typedef struct {
+    f64 time;
+    u16 code;  // EV_KEY_PRESSED, EV_KEY_RELEASED, EV_MB_PRESSED, ...
+    u16 value; // keys or mouse_buttons
+} input_event_t;
+
 // engine state
 void input_sys_init(void);
 void input_sys_kill(void);
+// once per frame after events are flushed, before game update
 void input_sys_update(f64 delta);
 const char *input_sys_keyname(keys k);
 
 // platform layer
-void input_process_key(keys key, b8 pressed);
+void input_process_key(keys key, b8 pressed, f64 time);
 void input_process_mods(u8 mods);
-void input_process_mouse_button(mouse_buttons button, b8 pressed);
+void input_process_mouse_button(mouse_buttons button, b8 pressed,
+                                f64 time);
 void input_process_mouse_move(i16 x, i16 y);
 void input_process_mouse_wheel(i8 z_delta);
+// unaccelerated relative motion, summed until the next update
+void input_process_mouse_raw(f64 dx, f64 dy);
 
 // input logic
 AM2_API b8 input_keydown(keys key);
@@ -112,6 +151,23 @@ AM2_API b8 input_mouse_button_up(mouse_buttons button);
 AM2_API b8 input_mouse_was_button_down(mouse_buttons button);
 AM2_API b8 input_mouse_was_button_up(mouse_buttons button);
 AM2_API void input_get_mouse_pos(i32 *x, i32 *y);
+
+// edges between the last two input_sys_update calls
+AM2_API b8 input_key_pressed(keys key);
+AM2_API b8 input_key_released(keys key);
+AM2_API b8 input_pressed_any(input_mask_t mask);
+AM2_API b8 input_released_any(input_mask_t mask);
+
+// every bit of mask held at the last input_sys_update, pressed also
+// needs one of them new this frame
+AM2_API b8 input_chord_down(input_mask_t mask);
+AM2_API b8 input_chord_pressed(input_mask_t mask);
+
+// every transition that happened before the last input_sys_update, in
+// arrival order, valid until the next update
+AM2_API u32 input_get_events(const input_event_t **out);
 AM2_API void input_get_mouse_prev_pos(i32 *x, i32 *y);
+// raw motion of the last frame, independent of pointer speed settings
+AM2_API void input_get_mouse_delta(f64 *dx, f64 *dy);
 
 #endif // INPUT_H
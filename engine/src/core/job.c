@@ -0,0 +1,359 @@
+#include "job.h"
+#include "memory.h"
+#include "platform/platform.h"
+
+#define JOB_MAX_THREADS 64
+#define JOB_DEQUE_SIZE 4096 // must be power of two
+#define JOB_SPIN_COUNT 64   // empty steal rounds before a worker sleeps
+#define JOB_NO_THREAD 0xFFFFFFFF
+#define CACHE_LINE 64
+
+typedef struct {
+    job_fn fn;
+    void *ctx;
+    job_counter_t *counter;
+    u32 start;
+    u32 end;
+} job_t;
+
+// Slots go through relaxed word copies. A thief can read a slot the
+// owner is rewriting, its CAS then fails and drops the copy, but the
+// access must not be a plain data race.
+typedef union {
+    job_t job;
+    u64 words[sizeof(job_t) / sizeof(u64)];
+} job_slot_t;
+
+STATIC_ASSERT(sizeof(job_t) % sizeof(u64) == 0, job_fits_words);
+
+// Chase-Lev deque. The owner pushes and takes at bottom, thieves take
+// from top, only the last item has owner and thieves racing on top.
+// Jobs are stored by value: a thief copies the slot before its CAS on
+// top, and a push can only reuse that slot after top moved, in which
+// case the CAS fails and the copy is dropped.
+typedef struct {
+    ALIGN(CACHE_LINE) u64 top;
+    ALIGN(CACHE_LINE) u64 bottom;
+    ALIGN(CACHE_LINE) job_slot_t items[JOB_DEQUE_SIZE];
+    u32 rng;
+} job_thread_t;
+
+typedef struct {
+    job_thread_t *threads[JOB_MAX_THREADS];
+    platform_thread_t handles[JOB_MAX_THREADS];
+    u32 thread_count;
+
+    platform_semaphore_t wake;
+    u32 sleeping;
+    u32 waking; // a post is on its way, further pushes need not post
+    u32 running;
+} job_system_t;
+
+static b8 initialized = false;
+static job_system_t g_job = {0};
+static __thread u32 t_job_index = JOB_NO_THREAD;
+
+static INL void slot_write(job_slot_t *slot, const job_t *job)
+{
+    job_slot_t v;
+    v.job = *job;
+    for (u32 i = 0; i < sizeof(v.words) / sizeof(v.words[0]); ++i)
+    {
+        atomic_store_u64(&slot->words[i], v.words[i], ATOMIC_RELAXED);
+    }
+}
+
+static INL void slot_read(job_slot_t *slot, job_t *out)
+{
+    job_slot_t v;
+    for (u32 i = 0; i < sizeof(v.words) / sizeof(v.words[0]); ++i)
+    {
+        v.words[i] = atomic_load_u64(&slot->words[i], ATOMIC_RELAXED);
+    }
+    *out = v.job;
+}
+
+static b8 deque_push(job_thread_t *t, const job_t *job)
+{
+    u64 b = atomic_load_u64(&t->bottom, ATOMIC_RELAXED);
+    u64 top = atomic_load_u64(&t->top, ATOMIC_ACQUIRE);
+    if (b - top >= JOB_DEQUE_SIZE) return false;
+
+    slot_write(&t->items[b & (JOB_DEQUE_SIZE - 1)], job);
+    atomic_store_u64(&t->bottom, b + 1, ATOMIC_RELEASE);
+    return true;
+}
+
+static b8 deque_take(job_thread_t *t, job_t *out)
+{
+    u64 b = atomic_load_u64(&t->bottom, ATOMIC_RELAXED) - 1;
+    atomic_store_u64(&t->bottom, b, ATOMIC_RELAXED);
+    atomic_fence(ATOMIC_SEQ_CST);
+    u64 top = atomic_load_u64(&t->top, ATOMIC_RELAXED);
+
+    // signed, b is one below top when the deque was empty
+    if ((i64)(b - top) < 0)
+    {
+        atomic_store_u64(&t->bottom, b + 1, ATOMIC_RELAXED);
+        return false;
+    }
+
+    slot_read(&t->items[b & (JOB_DEQUE_SIZE - 1)], out);
+    if (b == top)
+    {
+        // last item, a thief may be taking it through top as well
+        b8 won = atomic_cas_u64(&t->top, &top, top + 1, ATOMIC_SEQ_CST);
+        atomic_store_u64(&t->bottom, b + 1, ATOMIC_RELAXED);
+        return won;
+    }
+    return true;
+}
+
+static b8 deque_steal(job_thread_t *t, job_t *out)
+{
+    u64 top = atomic_load_u64(&t->top, ATOMIC_ACQUIRE);
+    atomic_fence(ATOMIC_SEQ_CST);
+    u64 b = atomic_load_u64(&t->bottom, ATOMIC_ACQUIRE);
+    if ((i64)(b - top) <= 0) return false;
+
+    slot_read(&t->items[top & (JOB_DEQUE_SIZE - 1)], out);
+
+    // false when the owner or another thief got it first
+    return atomic_cas_u64(&t->top, &top, top + 1, ATOMIC_SEQ_CST);
+}
+
+static void job_execute(const job_t *job)
+{
+    job->fn(job->ctx, job->start, job->end);
+    if (job->counter)
+    {
+        atomic_sub_u32(&job->counter->pending, 1, ATOMIC_RELEASE);
+    }
+}
+
+// own deque first, then one pass over the others from a random start
+static b8 job_find(u32 index, job_t *out)
+{
+    job_thread_t *self = g_job.threads[index];
+    if (deque_take(self, out)) return true;
+
+    // xorshift, only spreads thieves over victims
+    u32 x = self->rng;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    self->rng = x;
+
+    for (u32 i = 0; i < g_job.thread_count; ++i)
+    {
+        u32 victim = (x + i) % g_job.thread_count;
+        if (victim == index) continue;
+
+        if (deque_steal(g_job.threads[victim], out)) return true;
+    }
+    return false;
+}
+
+// Wake one sleeper unless a wake is already under way. The woken worker
+// clears waking before it searches, and wakes the next one once it
+// found work, so a burst of pushes ramps workers up one post at a time.
+static void job_notify(void)
+{
+    atomic_fence(ATOMIC_SEQ_CST);
+    if (!atomic_load_u32(&g_job.sleeping, ATOMIC_SEQ_CST)) return;
+
+    u32 idle = 0;
+    if (atomic_cas_u32(&g_job.waking, &idle, 1, ATOMIC_SEQ_CST))
+    {
+        platform_semaphore_post(&g_job.wake, 1);
+    }
+}
+
+static void job_worker(void *arg)
+{
+    u32 index = (u32)(uptr)arg;
+    t_job_index = index;
+
+    u32 idle = 0;
+    b8 woken = false;
+    while (atomic_load_u32(&g_job.running, ATOMIC_ACQUIRE))
+    {
+        job_t job;
+        if (job_find(index, &job))
+        {
+            // more may be queued, pass the wake on
+            if (woken) job_notify();
+            woken = false;
+            job_execute(&job);
+            idle = 0;
+            continue;
+        }
+
+        if (++idle < JOB_SPIN_COUNT)
+        {
+            atomic_pause();
+            continue;
+        }
+
+        // Announce the sleep, then look once more. A push before the
+        // announcement is found here, one after it sees the sleeper and
+        // posts, both sides fence so one of them always sees the other.
+        atomic_add_u32(&g_job.sleeping, 1, ATOMIC_SEQ_CST);
+        atomic_fence(ATOMIC_SEQ_CST);
+        if (job_find(index, &job))
+        {
+            atomic_sub_u32(&g_job.sleeping, 1, ATOMIC_SEQ_CST);
+            job_execute(&job);
+            idle = 0;
+            continue;
+        }
+
+        platform_semaphore_wait(&g_job.wake);
+        atomic_sub_u32(&g_job.sleeping, 1, ATOMIC_SEQ_CST);
+        atomic_store_u32(&g_job.waking, 0, ATOMIC_SEQ_CST);
+        atomic_fence(ATOMIC_SEQ_CST);
+        woken = true;
+        idle = 0;
+    }
+}
+
+b8 job_sys_init(u32 worker_count)
+{
+    if (initialized)
+    {
+        return false;
+    }
+
+    if (worker_count == 0)
+    {
+        u32 cores = platform_get_processor_count();
+        worker_count = cores > 1 ? cores - 1 : 0;
+    }
+    if (worker_count > JOB_MAX_THREADS - 1)
+    {
+        worker_count = JOB_MAX_THREADS - 1;
+    }
+
+    g_job.thread_count = worker_count + 1;
+    for (u32 i = 0; i < g_job.thread_count; ++i)
+    {
+        // the cache line padding between top and bottom needs the
+        // struct itself on a line boundary, malloc only gives 16
+        g_job.threads[i] = mem_alloc_aligned(sizeof(job_thread_t), MEM_ENGINE);
+        g_job.threads[i]->rng = 0x9E3779B9u * (i + 1);
+    }
+
+    platform_semaphore_init(&g_job.wake, 0);
+    g_job.running = true;
+    t_job_index = 0;
+
+    for (u32 i = 1; i < g_job.thread_count; ++i)
+    {
+        if (!platform_thread_create(&g_job.handles[i], job_worker,
+                                    (void *)(uptr)i, "am2_job"))
+        {
+            LOGE("Job worker %u failed to start", i);
+        }
+    }
+
+    initialized = true;
+    LOGI("Job System Init: %u workers", worker_count);
+    return true;
+}
+
+void job_sys_kill(void)
+{
+    if (!initialized)
+    {
+        return;
+    }
+
+    atomic_store_u32(&g_job.running, false, ATOMIC_RELEASE);
+    platform_semaphore_post(&g_job.wake, g_job.thread_count);
+    for (u32 i = 1; i < g_job.thread_count; ++i)
+    {
+        platform_thread_join(&g_job.handles[i]);
+    }
+
+    for (u32 i = 0; i < g_job.thread_count; ++i)
+    {
+        mem_free_aligned(g_job.threads[i], sizeof(job_thread_t),
+                         MEM_ENGINE);
+    }
+
+    mem_zero(&g_job, sizeof(g_job));
+    t_job_index = JOB_NO_THREAD;
+    initialized = false;
+    LOGI("Job System Kill");
+}
+
+static void job_push(job_fn fn, void *ctx, job_counter_t *counter,
+                     u32 start, u32 end)
+{
+    if (counter) atomic_add_u32(&counter->pending, 1, ATOMIC_RELAXED);
+
+    u32 index = t_job_index;
+    job_t job = {fn, ctx, counter, start, end};
+    if (!initialized || index == JOB_NO_THREAD)
+    {
+        job_execute(&job);
+        return;
+    }
+
+    if (!deque_push(g_job.threads[index], &job))
+    {
+        // deque full, running it here is the natural back pressure
+        job_execute(&job);
+        return;
+    }
+
+    job_notify();
+}
+
+void job_run(job_fn fn, void *ctx, job_counter_t *counter)
+{
+    job_push(fn, ctx, counter, 0, 0);
+}
+
+void job_wait(job_counter_t *counter)
+{
+    u32 index = t_job_index;
+    while (atomic_load_u32(&counter->pending, ATOMIC_ACQUIRE))
+    {
+        // help instead of blocking, the awaited jobs are usually in
+        // this thread's own deque
+        job_t job;
+        if (index != JOB_NO_THREAD && job_find(index, &job))
+        {
+            job_execute(&job);
+        }
+        else
+        {
+            atomic_pause();
+        }
+    }
+}
+
+void job_parallel_for(u32 count, u32 batch, job_fn fn, void *ctx)
+{
+    if (count == 0) return;
+    if (batch == 0) batch = 1;
+
+    job_counter_t counter = {0};
+    for (u32 start = 0; start < count; start += batch)
+    {
+        u32 end = count - start > batch ? start + batch : count;
+        job_push(fn, ctx, &counter, start, end);
+    }
+    job_wait(&counter);
+}
+
+u32 job_thread_count(void)
+{
+    return initialized ? g_job.thread_count : 1;
+}
+
+u32 job_thread_index(void)
+{
+    return t_job_index == JOB_NO_THREAD ? 0 : t_job_index;
+}
@@ -0,0 +1,35 @@
+#ifndef JOB_H
+#define JOB_H
+
+#include "define.h"
+
+// runs items [start, end), plain jobs get 0, 0
+typedef void (*job_fn)(void *ctx, u32 start, u32 end);
+
+// number of jobs still running, zero it before first use
+typedef struct {
+    u32 pending;
+} job_counter_t;
+
+// one worker per core besides the main thread, 0 picks that
+b8 job_sys_init(u32 worker_count);
+
+void job_sys_kill(void);
+
+// queue fn on this thread, counter (optional) drops when it finished.
+// Threads the job system did not start run the job right away.
+AM2_API void job_run(job_fn fn, void *ctx, job_counter_t *counter);
+
+// run other jobs until counter reaches zero
+AM2_API void job_wait(job_counter_t *counter);
+
+// fn over [0, count) in slices of batch items, returns when all ran
+AM2_API void job_parallel_for(u32 count, u32 batch, job_fn fn, void *ctx);
+
+// workers plus the main thread
+AM2_API u32 job_thread_count(void);
+
+// 0 on the main thread, 1.. on workers, for per-thread scratch
+AM2_API u32 job_thread_index(void);
+
+#endif // JOB_H
@@ -0,0 +1,206 @@
+#include "latency.h"
+#include "memory.h"
+#include "platform/platform.h"
+
+#include <stdio.h>
+
+#define LATENCY_WINDOW 1024 // must be power of two
+#define LATENCY_BUCKETS 72  // 4 per octave of microseconds, 1us..~262ms
+#define LATENCY_PENDING 256
+#define BUFFER_SIZE 1024
+
+typedef struct {
+    // ring of the newest samples, oldest drops out of the histogram
+    f32 window[LATENCY_WINDOW];
+    u8 bucket_of[LATENCY_WINDOW];
+    u32 count;
+    u32 next;
+    f64 sum;
+    u32 histogram[LATENCY_BUCKETS];
+} latency_track_t;
+
+typedef struct {
+    latency_track_t stages[LATENCY_STAGE_COUNT];
+
+    // input times dispatched this frame, waiting for game update
+    f64 pending[LATENCY_PENDING];
+    u32 pending_count;
+} latency_system_t;
+
+static b8 initialized = false;
+static latency_system_t g_lat = {0};
+
+static const char *stage_str[LATENCY_STAGE_COUNT] = {
+    "arrival",
+    "dispatch",
+    "consume",
+};
+
+// log scale bucket, 4 steps per power of two
+static u8 latency_bucket(f64 seconds)
+{
+    u64 us = seconds > 0.0 ? (u64)(seconds * 1e6) : 0;
+    if (us < 4) return (u8)us;
+
+    u32 octave = 63 - (u32)__builtin_clzll(us);
+    u32 step = (u32)(us >> (octave - 2)) & 3;
+    u32 bucket = (octave - 1) * 4 + step;
+
+    return (u8)(bucket < LATENCY_BUCKETS ? bucket : LATENCY_BUCKETS - 1);
+}
+
+// lower edge of a bucket in seconds, inverse of latency_bucket
+static f64 latency_bucket_edge(u32 bucket)
+{
+    if (bucket < 4) return (f64)bucket * 1e-6;
+
+    u32 octave = bucket / 4 + 1;
+    u64 us = (u64)(4 + bucket % 4) << (octave - 2);
+    return (f64)us * 1e-6;
+}
+
+void latency_sys_init(void)
+{
+    mem_zero(&g_lat, sizeof(g_lat));
+    initialized = true;
+    LOGI("Latency System Init");
+}
+
+void latency_sys_kill(void)
+{
+    initialized = false;
+    LOGI("Latency System Kill");
+}
+
+void latency_sample(latency_stage_t stage, f64 input_time, f64 now)
+{
+    if (!initialized || input_time <= 0.0)
+    {
+        return;
+    }
+
+    latency_track_t *t = &g_lat.stages[stage];
+    f64 value = now - input_time;
+    if (value < 0.0) value = 0.0;
+
+    u32 slot = t->next;
+    if (t->count == LATENCY_WINDOW)
+    {
+        t->sum -= t->window[slot];
+        t->histogram[t->bucket_of[slot]]--;
+    }
+    else
+    {
+        t->count++;
+    }
+
+    u8 bucket = latency_bucket(value);
+    t->window[slot] = (f32)value;
+    t->bucket_of[slot] = bucket;
+    t->histogram[bucket]++;
+    t->sum += value;
+    t->next = (slot + 1) & (LATENCY_WINDOW - 1);
+}
+
+void latency_dispatched(f64 input_time, f64 now)
+{
+    if (!initialized)
+    {
+        return;
+    }
+
+    latency_sample(LATENCY_DISPATCH, input_time, now);
+    if (g_lat.pending_count < LATENCY_PENDING)
+    {
+        g_lat.pending[g_lat.pending_count++] = input_time;
+    }
+}
+
+void latency_frame_consumed(void)
+{
+    if (!initialized || g_lat.pending_count == 0)
+    {
+        return;
+    }
+
+    f64 now = platform_get_time();
+    for (u32 i = 0; i < g_lat.pending_count; ++i)
+    {
+        latency_sample(LATENCY_CONSUME, g_lat.pending[i], now);
+    }
+    g_lat.pending_count = 0;
+}
+
+b8 latency_get_stats(latency_stage_t stage, latency_stats_t *out)
+{
+    mem_zero(out, sizeof(latency_stats_t));
+    if (!initialized || stage >= LATENCY_STAGE_COUNT)
+    {
+        return false;
+    }
+
+    latency_track_t *t = &g_lat.stages[stage];
+    if (t->count == 0)
+    {
+        return true;
+    }
+
+    f32 min = t->window[0];
+    f32 max = t->window[0];
+    for (u32 i = 1; i < t->count; ++i)
+    {
+        if (t->window[i] < min) min = t->window[i];
+        if (t->window[i] > max) max = t->window[i];
+    }
+
+    // p99 is the upper edge of the bucket that crosses 99%
+    u32 target = t->count - t->count / 100;
+    u32 seen = 0;
+    u32 bucket = 0;
+    for (; bucket < LATENCY_BUCKETS; ++bucket)
+    {
+        seen += t->histogram[bucket];
+        if (seen >= target) break;
+    }
+    f64 p99 = bucket + 1 < LATENCY_BUCKETS ? latency_bucket_edge(bucket + 1)
+                                           : (f64)max;
+    if (p99 > (f64)max) p99 = (f64)max;
+
+    out->min = (f64)min * 1000.0;
+    out->max = (f64)max * 1000.0;
+    out->avg = t->sum / (f64)t->count * 1000.0;
+    out->p99 = p99 * 1000.0;
+    out->samples = t->count;
+    return true;
+}
+
+char *get_latency_report(void)
+{
+    static char buffer[BUFFER_SIZE];
+    u64 offset = 0;
+
+    offset += (u64)snprintf(buffer + offset, sizeof(buffer) - offset,
+                            "Input Latency (ms, last %u samples):\n",
+                            LATENCY_WINDOW);
+
+    for (u32 i = 0; i < LATENCY_STAGE_COUNT; ++i)
+    {
+        latency_stats_t s;
+        latency_get_stats((latency_stage_t)i, &s);
+        if (s.samples == 0) continue;
+
+        i32 length = snprintf(buffer + offset, sizeof(buffer) - offset,
+                              "--> %s: min %.3f, avg %.3f, p99 %.3f, max "
+                              "%.3f [%u]\n",
+                              stage_str[i], s.min, s.avg, s.p99, s.max,
+                              s.samples);
+
+        if (length > 0 && (offset + (u32)length < BUFFER_SIZE))
+        {
+            offset += (u32)length;
+        }
+        else
+            break;
+    }
+    return buffer;
+}
@@ -0,0 +1,40 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include "define.h"
+
+// every stage is measured from the input's own timestamp (X server time
+// converted to the platform_get_time base)
+typedef enum {
+    LATENCY_ARRIVAL,  // read by platform_pump
+    LATENCY_DISPATCH, // handlers ran in event_flush
+    LATENCY_CONSUME,  // game update of that frame returned
+    LATENCY_STAGE_COUNT
+} latency_stage_t;
+
+// rolling over the last LATENCY_WINDOW samples, in milliseconds
+typedef struct {
+    f64 min;
+    f64 avg;
+    f64 p99;
+    f64 max;
+    u32 samples;
+} latency_stats_t;
+
+void latency_sys_init(void);
+
+void latency_sys_kill(void);
+
+void latency_sample(latency_stage_t stage, f64 input_time, f64 now);
+
+// input of this frame was dispatched, remembered until consume
+void latency_dispatched(f64 input_time, f64 now);
+
+// call after game update, closes every input dispatched this frame
+void latency_frame_consumed(void);
+
+AM2_API b8 latency_get_stats(latency_stage_t stage, latency_stats_t *out);
+
+AM2_API char *get_latency_report(void);
+
+#endif // LATENCY_H
@@ -9,6 +9,10 @@ struct mem_stats {
     u64 total_allocated;
     u64 tag_allocations[MEM_MAX_TAG];
     u64 alloc_count[MEM_MAX_TAG];
+
+    u64 total_mapped;
+    u64 tag_mapped[MEM_MAX_TAG];
+    u64 map_count[MEM_MAX_TAG];
 };
 
 static struct mem_stats g_stats = {0};
@@ -72,6 +76,94 @@ void mem_free(void *block, u64 size, memtag_t tag)
     platform_free(block, false);
 }
 
+void *mem_alloc_aligned(u64 size, memtag_t tag)
+{
+    if (tag == MEM_UNKNOWN)
+    {
+        LOGW("allocation using MEM_UNKNOWN");
+    }
+
+    void *block = platform_alloc(size, true);
+    if (!block)
+    {
+        LOGE("Aligned allocation of %llu bytes failed", size);
+        return 0;
+    }
+
+    g_stats.total_allocated += size;
+    g_stats.tag_allocations[tag] += size;
+    g_stats.alloc_count[tag]++;
+
+    platform_memzero(block, size);
+    return block;
+}
+
+void mem_free_aligned(void *block, u64 size, memtag_t tag)
+{
+    if (!block) return;
+
+    g_stats.total_allocated -= size;
+    g_stats.tag_allocations[tag] -= size;
+    g_stats.alloc_count[tag]--;
+
+    platform_free(block, true);
+}
+
+void *mem_alloc_stack(u64 size, memtag_t tag)
+{
+    void *stack = platform_stack_alloc(size);
+    if (!stack)
+    {
+        LOGE("Stack allocation of %llu bytes failed", size);
+        return 0;
+    }
+
+    g_stats.total_allocated += size;
+    g_stats.tag_allocations[tag] += size;
+    g_stats.alloc_count[tag]++;
+    return stack;
+}
+
+void mem_free_stack(void *stack, u64 size, memtag_t tag)
+{
+    if (!stack) return;
+
+    g_stats.total_allocated -= size;
+    g_stats.tag_allocations[tag] -= size;
+    g_stats.alloc_count[tag]--;
+
+    platform_stack_free(stack, size);
+}
+
+const void *mem_map_file(const char *path, u32 flags, u64 *size,
+                         memtag_t tag)
+{
+    if (tag == MEM_UNKNOWN)
+    {
+        LOGW("file map using MEM_UNKNOWN");
+    }
+
+    const void *data = platform_file_map(path, flags, size);
+    if (!data) return 0;
+
+    g_stats.total_mapped += *size;
+    g_stats.tag_mapped[tag] += *size;
+    g_stats.map_count[tag]++;
+
+    return data;
+}
+
+void mem_unmap_file(const void *data, u64 size, memtag_t tag)
+{
+    if (!data) return;
+
+    g_stats.total_mapped -= size;
+    g_stats.tag_mapped[tag] -= size;
+    g_stats.map_count[tag]--;
+
+    platform_file_unmap(data, size);
+}
+
 void *mem_zero(void *block, u64 size) { return platform_memzero(block, size); }
 
 void *mem_copy(void *dest, const void *src, u64 size)
@@ -89,44 +181,41 @@ void *mem_set(void *dest, i32 value, u64 size)
     return platform_memsets(dest, value, size);
 }
 
-char *get_usage_mem(void)
+// scales bytes to the largest unit that keeps it at 1 or more
+static const char *mem_unit(f32 *amount)
 {
-    static char buffer[BUFFER_SIZE];
-    u64 offset = 0;
-
-    f32 used_mib = (f32)g_stats.total_allocated / (f32)MEBIBYTE;
-    f32 reserved_mib = (f32)g_mem_size / (f32)MEBIBYTE;
-
-    offset += (u64)snprintf(buffer + offset, sizeof(buffer) - offset,
-                            "Engine Memory Used: %.6f Mib / %.2f Mib\n",
-                            used_mib, reserved_mib);
+    if (*amount >= (f32)GIBIBYTE)
+    {
+        *amount /= (f32)GIBIBYTE;
+        return "Gib";
+    }
+    else if (*amount >= (f32)MEBIBYTE)
+    {
+        *amount /= (f32)MEBIBYTE;
+        return "Mib";
+    }
+    else if (*amount >= (f32)KIBIBYTE)
+    {
+        *amount /= (f32)KIBIBYTE;
+        return "Kib";
+    }
+    return "B";
+}
 
+// one line per tag in use, returns the new offset into buffer
+static u64 mem_print_tags(char *buffer, u64 offset, const u64 *bytes,
+                          const u64 *counts)
+{
     for (u32 i = 0; i < MEM_MAX_TAG; ++i)
     {
-        char *unit = "B";
-        u32 count = (u32)g_stats.alloc_count[i];
-        f32 amount = (f32)g_stats.tag_allocations[i];
+        u32 count = (u32)counts[i];
+        f32 amount = (f32)bytes[i];
 
         if (count == 0) continue;
 
-        if (amount >= (f32)GIBIBYTE)
-        {
-            amount /= (f32)GIBIBYTE;
-            unit = "Gib";
-        }
-        else if (amount >= (f32)MEBIBYTE)
-        {
-            amount /= (f32)MEBIBYTE;
-            unit = "Mib";
-        }
-        else if (amount >= (f32)KIBIBYTE)
-        {
-            amount /= (f32)KIBIBYTE;
-            unit = "Kib";
-        }
-
+        const char *unit = mem_unit(&amount);
         i32 length =
-            snprintf(buffer + offset, sizeof(buffer) - offset,
+            snprintf(buffer + offset, BUFFER_SIZE - offset,
                      "--> %s: [%u] %.2f%s\n", tag_str[i], count, amount, unit);
 
         if (length > 0 && (offset + (u32)length < BUFFER_SIZE))
@@ -136,5 +225,33 @@ char *get_usage_mem(void)
         else
             break;
     }
+    return offset;
+}
+
+char *get_usage_mem(void)
+{
+    static char buffer[BUFFER_SIZE];
+    u64 offset = 0;
+
+    f32 used_mib = (f32)g_stats.total_allocated / (f32)MEBIBYTE;
+    f32 reserved_mib = (f32)g_mem_size / (f32)MEBIBYTE;
+
+    offset += (u64)snprintf(buffer + offset, sizeof(buffer) - offset,
+                            "Engine Memory Used: %.6f Mib / %.2f Mib\n",
+                            used_mib, reserved_mib);
+    offset = mem_print_tags(buffer, offset, g_stats.tag_allocations,
+                            g_stats.alloc_count);
+
+    if (g_stats.total_mapped == 0) return buffer;
+
+    // file views live in the page cache, kept apart from the heap total
+    f32 mapped_mib = (f32)g_stats.total_mapped / (f32)MEBIBYTE;
+    i32 length = snprintf(buffer + offset, sizeof(buffer) - offset,
+                          "Mapped Files: %.6f Mib\n", mapped_mib);
+    if (length > 0 && (offset + (u32)length < BUFFER_SIZE))
+    {
+        offset += (u32)length;
+        mem_print_tags(buffer, offset, g_stats.tag_mapped, g_stats.map_count);
+    }
     return buffer;
 }
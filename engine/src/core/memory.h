@@ -28,6 +28,24 @@ AM2_API void *mem_alloc(u64 size, memtag_t tag);
 
 AM2_API void mem_free(void *block, u64 size, memtag_t tag);
 
+// zeroed like mem_alloc, starts on a 4096 byte boundary (a page, and
+// whole cache lines for padded structs or O_DIRECT buffers)
+AM2_API void *mem_alloc_aligned(u64 size, memtag_t tag);
+
+AM2_API void mem_free_aligned(void *block, u64 size, memtag_t tag);
+
+// guarded stack from platform_stack_alloc, counted against tag
+void *mem_alloc_stack(u64 size, memtag_t tag);
+
+void mem_free_stack(void *stack, u64 size, memtag_t tag);
+
+// Read only view of a file, see platform_file_map for flags. Reported
+// per tag apart from heap memory, the pages belong to the page cache.
+AM2_API const void *mem_map_file(const char *path, u32 flags, u64 *size,
+                                 memtag_t tag);
+
+AM2_API void mem_unmap_file(const void *data, u64 size, memtag_t tag);
+
 AM2_API void *mem_zero(void *block, u64 size);
 
 AM2_API void *mem_copy(void *dest, const void *src, u64 size);
@@ -0,0 +1,105 @@
+#include "test_event.h"
+#include "core/fmt.h"
+#include "event.h"
+#include "platform/platform.h"
+
+#define TEST_START(name) pfmt("Testing %s...\n", name)
+#define TEST_PASS() pfmt("PASS\n")
+
+#define PRODUCERS 8
+#define EVENTS_PER_PRODUCER 100000
+#define TEST_CODE 0x4000
+
+typedef struct {
+    u32 id;
+    u32 full_count;
+} producer_t;
+
+static u32 g_next_seq[PRODUCERS];
+static u32 g_received;
+
+static b8 on_async(u16 code, void *sender, void *recipient, event_ctx_t ctx)
+{
+    (void)code;
+    (void)sender;
+    (void)recipient;
+
+    u32 id = ctx.data.u32[0];
+    u32 seq = ctx.data.u32[1];
+
+    // per producer order must survive the queue and the code sort
+    AM2_ASSERT(id < PRODUCERS);
+    AM2_ASSERT(seq == g_next_seq[id]);
+
+    g_next_seq[id]++;
+    g_received++;
+    return true;
+}
+
+static void producer_run(void *arg)
+{
+    producer_t *p = (producer_t *)arg;
+
+    for (u32 i = 0; i < EVENTS_PER_PRODUCER; ++i)
+    {
+        event_ctx_t ctx = {0};
+        ctx.data.u32[0] = p->id;
+        ctx.data.u32[1] = i;
+
+        // full queue is expected under load, spin until the consumer
+        // catches up
+        while (!event_post_async(TEST_CODE, 0, ctx))
+        {
+            p->full_count++;
+        }
+    }
+}
+
+void event_async_test(void)
+{
+    pfmt("\n");
+
+    TEST_START("event_post_async with many producers");
+
+    event_handle_t handle = event_reg(TEST_CODE, 0, on_async);
+    AM2_ASSERT(handle != 0);
+
+    platform_thread_t threads[PRODUCERS];
+    producer_t producers[PRODUCERS];
+
+    for (u32 i = 0; i < PRODUCERS; ++i)
+    {
+        g_next_seq[i] = 0;
+        producers[i].id = i;
+        producers[i].full_count = 0;
+        platform_thread_create(&threads[i], producer_run, &producers[i],
+                               "ev_producer");
+    }
+
+    // main thread drains while producers are still running
+    const u32 total = PRODUCERS * EVENTS_PER_PRODUCER;
+    while (atomic_load_u32(&g_received, ATOMIC_RELAXED) < total)
+    {
+        event_flush();
+    }
+
+    u32 full_count = 0;
+    for (u32 i = 0; i < PRODUCERS; ++i)
+    {
+        platform_thread_join(&threads[i]);
+        full_count += producers[i].full_count;
+        AM2_ASSERT(g_next_seq[i] == EVENTS_PER_PRODUCER);
+    }
+
+    // nothing left behind and nothing duplicated
+    event_flush();
+    AM2_ASSERT(g_received == total);
+
+    pfmt("%u events, producers hit a full queue %u times\n", total,
+         full_count);
+
+    event_unreg(handle);
+    TEST_PASS();
+
+    pfmt("\n");
+}
@@ -0,0 +1,6 @@
+#ifndef TEST_EVENT_H
+#define TEST_EVENT_H
+
+void event_async_test(void);
+
+#endif // TEST_EVENT_H
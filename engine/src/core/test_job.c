@@ -0,0 +1,179 @@
+#include "test_job.h"
+#include "core/fmt.h"
+#include "job.h"
+#include "platform/platform.h"
+
+#define TEST_START(name) pfmt("Testing %s...\n", name)
+#define TEST_PASS() pfmt("PASS\n")
+
+// more workers than most test machines have cores, so thieves contend
+#define TEST_WORKERS 7
+#define ITEMS 100003 // prime, no batch divides it
+#define STEAL_JOBS 4000 // fits one deque
+#define BURST_JOBS 20000
+#define NESTED_PARENTS 1000
+#define NESTED_CHILDREN 10
+#define WAKE_ROUNDS 200
+
+static u8 g_hits[ITEMS];
+static u32 g_ran_on[64];
+static u32 g_leaves;
+
+static void mark_items(void *ctx, u32 start, u32 end)
+{
+    (void)ctx;
+    // slices never overlap, a plain increment shows any double run
+    for (u32 i = start; i < end; ++i) g_hits[i]++;
+}
+
+static void count_thread(void *ctx, u32 start, u32 end)
+{
+    (void)ctx;
+    (void)start;
+    (void)end;
+    atomic_add_u32(&g_ran_on[job_thread_index()], 1, ATOMIC_RELAXED);
+}
+
+static void leaf(void *ctx, u32 start, u32 end)
+{
+    (void)ctx;
+    (void)start;
+    (void)end;
+    atomic_add_u32(&g_leaves, 1, ATOMIC_RELAXED);
+}
+
+static void parent(void *ctx, u32 start, u32 end)
+{
+    (void)ctx;
+    for (u32 p = start; p < end; ++p)
+    {
+        job_counter_t children = {0};
+        for (u32 i = 0; i < NESTED_CHILDREN; ++i)
+        {
+            job_run(leaf, 0, &children);
+        }
+        job_wait(&children);
+    }
+}
+
+static void test_parallel_for(void)
+{
+    static const u32 batches[] = {1, 7, 64, 1000, ITEMS, ITEMS + 5};
+
+    TEST_START("job_parallel_for with uneven slices");
+    for (u32 b = 0; b < sizeof(batches) / sizeof(batches[0]); ++b)
+    {
+        for (u32 i = 0; i < ITEMS; ++i) g_hits[i] = 0;
+
+        job_parallel_for(ITEMS, batches[b], mark_items, 0);
+
+        // every item exactly once, the tail slice included
+        for (u32 i = 0; i < ITEMS; ++i) AM2_ASSERT(g_hits[i] == 1);
+    }
+    job_parallel_for(0, 16, mark_items, 0);
+    TEST_PASS();
+}
+
+static u32 ran_total(u32 *on_workers)
+{
+    u32 total = 0;
+    *on_workers = 0;
+    for (u32 i = 0; i < job_thread_count(); ++i)
+    {
+        total += g_ran_on[i];
+        if (i) *on_workers += g_ran_on[i];
+    }
+    return total;
+}
+
+static void test_steal(void)
+{
+    TEST_START("many workers stealing a burst");
+    u32 stolen = 0;
+
+    // the main thread only watches, every job has to be stolen
+    for (u32 i = 0; i < 64; ++i) g_ran_on[i] = 0;
+    job_counter_t counter = {0};
+    for (u32 i = 0; i < STEAL_JOBS; ++i)
+    {
+        job_run(count_thread, 0, &counter);
+    }
+    while (atomic_load_u32(&counter.pending, ATOMIC_ACQUIRE))
+    {
+        platform_sleep(0);
+    }
+    AM2_ASSERT(ran_total(&stolen) == STEAL_JOBS);
+    AM2_ASSERT(stolen == STEAL_JOBS);
+
+    // now the owner takes from the bottom while thieves take from the
+    // top, and more than a deque holds runs inline on the pusher
+    for (u32 i = 0; i < 64; ++i) g_ran_on[i] = 0;
+    for (u32 i = 0; i < BURST_JOBS; ++i)
+    {
+        job_run(count_thread, 0, &counter);
+    }
+    job_wait(&counter);
+    u32 total = ran_total(&stolen);
+    AM2_ASSERT(total == BURST_JOBS);
+
+    pfmt("%u jobs, %u ran on workers\n", total, stolen);
+    TEST_PASS();
+}
+
+static void test_nested(void)
+{
+    TEST_START("nested jobs waiting on their children");
+    g_leaves = 0;
+    job_parallel_for(NESTED_PARENTS, 3, parent, 0);
+    AM2_ASSERT(g_leaves == NESTED_PARENTS * NESTED_CHILDREN);
+    TEST_PASS();
+}
+
+static void test_wake(void)
+{
+    TEST_START("sleeping workers wake for every push");
+
+    // The main thread never helps here: the job sits in its deque until
+    // a worker steals it, so a lost wakeup hangs the round.
+    for (u32 round = 0; round < WAKE_ROUNDS; ++round)
+    {
+        platform_sleep(1);
+
+        job_counter_t counter = {0};
+        job_run(leaf, 0, &counter);
+
+        f64 deadline = platform_get_time() + 1.0;
+        while (atomic_load_u32(&counter.pending, ATOMIC_ACQUIRE))
+        {
+            if (platform_get_time() > deadline)
+            {
+                LOGE("Job of round %u never ran, lost wakeup", round);
+                AM2_ASSERT(false);
+                // drain it so the counter outlives no job
+                job_wait(&counter);
+                break;
+            }
+            atomic_pause();
+        }
+    }
+    TEST_PASS();
+}
+
+void job_test(void)
+{
+    pfmt("\n");
+
+    // own worker count for the run, the engine's is restored after
+    job_sys_kill();
+    job_sys_init(TEST_WORKERS);
+
+    test_parallel_for();
+    test_steal();
+    test_nested();
+    test_wake();
+
+    job_sys_kill();
+    job_sys_init(0);
+
+    pfmt("\n");
+}
@@ -0,0 +1,6 @@
+#ifndef TEST_JOB_H
+#define TEST_JOB_H
+
+void job_test(void);
+
+#endif // TEST_JOB_H
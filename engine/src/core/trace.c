@@ -0,0 +1,232 @@
+#include "trace.h"
+#include "input.h"
+#include "platform/platform.h"
+
+#include <stdio.h>
+
+#define TRACE_MAGIC 0x544D4132 // "2AMT"
+#define TRACE_VERSION 4
+
+typedef struct {
+    u32 magic;
+    u32 version;
+    u32 record_size;
+    u32 reserved;
+} trace_header_t;
+
+typedef struct {
+    u32 frame;
+    u16 code;
+    u8 kind;
+    u8 pad;
+    f64 time; // seconds since the trace started
+    event_ctx_t ctx;
+} trace_record_t;
+
+STATIC_ASSERT(sizeof(trace_record_t) == 32, trace_record_is_32_bytes);
+
+typedef struct {
+    trace_mode_t mode;
+    FILE *file;
+    f64 start_time;
+    u64 frame;
+
+    // replay lookahead, valid while has_next
+    trace_record_t next;
+    b8 has_next;
+
+    // frame time summary, printed on kill
+    f64 last_frame_time;
+    f64 frame_time_sum;
+    f64 frame_time_min;
+    f64 frame_time_max;
+    u64 frame_count;
+} trace_system_t;
+
+static trace_system_t g_trace = {0};
+
+static void trace_read_next(void)
+{
+    g_trace.has_next =
+        fread(&g_trace.next, sizeof(trace_record_t), 1, g_trace.file) == 1;
+}
+
+b8 trace_sys_init(const char *record_path, const char *replay_path)
+{
+    g_trace.mode = TRACE_OFF;
+    g_trace.start_time = platform_get_time();
+    g_trace.frame_time_min = 1e30;
+
+    if (record_path && replay_path)
+    {
+        LOGE("Trace cannot record and replay at the same time");
+        return false;
+    }
+
+    if (record_path)
+    {
+        g_trace.file = fopen(record_path, "wb");
+        if (!g_trace.file)
+        {
+            LOGE("Trace failed to open '%s' for recording", record_path);
+            return false;
+        }
+
+        trace_header_t header = {TRACE_MAGIC, TRACE_VERSION,
+                                 sizeof(trace_record_t), 0};
+        fwrite(&header, sizeof(header), 1, g_trace.file);
+
+        g_trace.mode = TRACE_RECORD;
+        LOGI("Trace recording to '%s'", record_path);
+    }
+    else if (replay_path)
+    {
+        g_trace.file = fopen(replay_path, "rb");
+        if (!g_trace.file)
+        {
+            LOGE("Trace failed to open '%s' for replay", replay_path);
+            return false;
+        }
+
+        trace_header_t header = {0};
+        if (fread(&header, sizeof(header), 1, g_trace.file) != 1 ||
+            header.magic != TRACE_MAGIC || header.version != TRACE_VERSION ||
+            header.record_size != sizeof(trace_record_t))
+        {
+            LOGE("Trace '%s' is not a valid trace file", replay_path);
+            fclose(g_trace.file);
+            g_trace.file = 0;
+            return false;
+        }
+
+        trace_read_next();
+        g_trace.mode = TRACE_REPLAY;
+        LOGI("Trace replaying '%s'", replay_path);
+    }
+
+    return true;
+}
+
+void trace_sys_kill(void)
+{
+    if (g_trace.mode == TRACE_RECORD)
+    {
+        event_ctx_t ctx = {0};
+        trace_capture(TRACE_END, 0, ctx);
+    }
+
+    if (g_trace.mode == TRACE_REPLAY && g_trace.frame_count > 0)
+    {
+        LOGI("Trace replay: %llu frames, frame time avg %.4f ms, min %.4f "
+             "ms, max %.4f ms",
+             g_trace.frame_count,
+             g_trace.frame_time_sum / (f64)g_trace.frame_count * 1000.0,
+             g_trace.frame_time_min * 1000.0, g_trace.frame_time_max * 1000.0);
+    }
+
+    if (g_trace.file)
+    {
+        fclose(g_trace.file);
+    }
+
+    g_trace = (trace_system_t){0};
+}
+
+trace_mode_t trace_get_mode(void) { return g_trace.mode; }
+
+f64 trace_frame(u64 frame, f64 delta)
+{
+    g_trace.frame = frame;
+
+    if (g_trace.mode == TRACE_RECORD)
+    {
+        event_ctx_t ctx = {0};
+        ctx.data.f64[0] = delta;
+        trace_capture(TRACE_FRAME, 0, ctx);
+        return delta;
+    }
+
+    if (g_trace.mode != TRACE_REPLAY) return delta;
+
+    // the previous trace_replay_frame left this frame's records next
+    if (g_trace.has_next && g_trace.next.frame == frame &&
+        g_trace.next.kind == TRACE_FRAME)
+    {
+        delta = g_trace.next.ctx.data.f64[0];
+        trace_read_next();
+    }
+
+    f64 now = platform_get_time();
+    if (g_trace.last_frame_time > 0.0)
+    {
+        f64 dt = now - g_trace.last_frame_time;
+        g_trace.frame_time_sum += dt;
+        if (dt < g_trace.frame_time_min) g_trace.frame_time_min = dt;
+        if (dt > g_trace.frame_time_max) g_trace.frame_time_max = dt;
+        g_trace.frame_count++;
+    }
+    g_trace.last_frame_time = now;
+    return delta;
+}
+
+void trace_capture(trace_kind_t kind, u16 code, event_ctx_t ctx)
+{
+    trace_capture_at(kind, code, ctx, 0.0);
+}
+
+void trace_capture_at(trace_kind_t kind, u16 code, event_ctx_t ctx,
+                      f64 time)
+{
+    if (g_trace.mode != TRACE_RECORD) return;
+
+    trace_record_t rec = {0};
+    rec.frame = (u32)g_trace.frame;
+    rec.code = code;
+    rec.kind = (u8)kind;
+    rec.time = (time > 0.0 ? time : platform_get_time()) - g_trace.start_time;
+    rec.ctx = ctx;
+
+    fwrite(&rec, sizeof(rec), 1, g_trace.file);
+}
+
+b8 trace_replay_frame(void)
+{
+    if (g_trace.mode != TRACE_REPLAY) return false;
+
+    while (g_trace.has_next && g_trace.next.frame <= g_trace.frame)
+    {
+        trace_record_t *rec = &g_trace.next;
+        event_ctx_t ctx = rec->ctx;
+
+        // keep the recorded spacing, rebased onto this run's clock
+        f64 time = g_trace.start_time + rec->time;
+
+        switch ((trace_kind_t)rec->kind)
+        {
+        case TRACE_KEY:
+            input_process_key((keys)ctx.data.u16[0], ctx.data.u8[2], time);
+            break;
+        case TRACE_MODS: input_process_mods(ctx.data.u8[0]); break;
+        case TRACE_BUTTON:
+            input_process_mouse_button((mouse_buttons)ctx.data.u16[0],
+                                       ctx.data.u8[2], time);
+            break;
+        case TRACE_MOVE:
+            input_process_mouse_move(ctx.data.i16[0], ctx.data.i16[1]);
+            break;
+        case TRACE_WHEEL:
+            input_process_mouse_wheel((i8)ctx.data.i32[0]);
+            break;
+        case TRACE_RAW:
+            input_process_mouse_raw(ctx.data.f64[0], ctx.data.f64[1]);
+            break;
+        case TRACE_EVENT: event_post(rec->code, 0, ctx); break;
+        case TRACE_FRAME: break; // taken by trace_frame
+        case TRACE_END: g_trace.has_next = false; return false;
+        }
+
+        trace_read_next();
+    }
+
+    return g_trace.has_next;
+}
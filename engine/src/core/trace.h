@@ -0,0 +1,49 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "define.h"
+#include "event.h"
+
+typedef enum {
+    TRACE_OFF,
+    TRACE_RECORD,
+    TRACE_REPLAY,
+} trace_mode_t;
+
+// what a record replays into
+typedef enum {
+    TRACE_KEY,    // input_process_key
+    TRACE_MODS,   // input_process_mods
+    TRACE_BUTTON, // input_process_mouse_button
+    TRACE_MOVE,   // input_process_mouse_move
+    TRACE_WHEEL,  // input_process_mouse_wheel
+    TRACE_RAW,    // input_process_mouse_raw
+    TRACE_EVENT,  // event_post from the platform layer
+    TRACE_END,    // last recorded frame, replay stops here
+    TRACE_FRAME,  // frame delta, first record of every frame
+} trace_kind_t;
+
+// at most one path set, both null leaves tracing off
+b8 trace_sys_init(const char *record_path, const char *replay_path);
+
+void trace_sys_kill(void);
+
+trace_mode_t trace_get_mode(void);
+
+// Call once per frame before input is pumped or replayed. Returns the
+// delta the frame simulates: the recorded one when replaying, else
+// delta itself, which recording stores so replay takes the same steps.
+f64 trace_frame(u64 frame, f64 delta);
+
+// record hook, no-op unless recording
+void trace_capture(trace_kind_t kind, u16 code, event_ctx_t ctx);
+
+// same with the input's own platform_get_time stamp, replay hands it
+// back so sub frame timing and latency survive (<= 0 stamps now)
+void trace_capture_at(trace_kind_t kind, u16 code, event_ctx_t ctx,
+                      f64 time);
+
+// feed every record of the current frame, false once the stream ended
+b8 trace_replay_frame(void);
+
+#endif // TRACE_H
@@ -7,14 +7,38 @@ typedef struct {
     u32 width;
     u32 height;
     char *name;
+
+    // binary input trace, record a session or replay one instead of
+    // pumping the platform (at most one set)
+    const char *trace_record;
+    const char *trace_replay;
+
+    // no window, input from platform_inject_* or trace_replay
+    b8 headless;
+
+    // frames per second, 0 paces frames to update_rate (input still
+    // wakes one early)
+    u32 target_fps;
+    // fixed update steps per second (default 60) and how many may run
+    // in one frame to catch up (default 5)
+    u32 update_rate;
+    u32 max_update_steps;
+
+    // frames only on input or application_request_frame
+    b8 render_on_demand;
+
+    // frame cap while the window has no focus, 0 keeps target_fps
+    u32 background_fps;
 } application_config_t;
 
 typedef struct game_entry_t {
     application_config_t config;
 
     b8 (*init)(struct game_entry_t *game_inst);
+    // delta is always the fixed step
     b8 (*update)(struct game_entry_t *game_inst, f32 delta);
-    b8 (*render)(struct game_entry_t *game_inst, f32 delta);
+    // alpha in [0, 1) is how far time is between the last two updates
+    b8 (*render)(struct game_entry_t *game_inst, f32 alpha);
     void (*resize)(struct game_entry_t *game_inst, u32 width, u32 height);
 
     void *game_state;
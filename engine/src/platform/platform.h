@@ -2,9 +2,11 @@
 #define PLATFORM_H
 
 #include "core/define.h"
+#include "core/input.h"
 
 typedef struct {
     void *internal_data;
+    b8 headless; // set before platform_init, forced by -DAM2_HEADLESS
 } platform_system_t;
 
 b8 platform_init(platform_system_t *ps, const char *name, i32 width,
@@ -14,14 +16,79 @@ void platform_kill(platform_system_t *ps);
 
 b8 platform_pump(platform_system_t *ps);
 
+// block until the platform has input, platform_wake is called or timeout
+// seconds pass (negative waits forever), true when woken early
+b8 platform_wait(platform_system_t *ps, f64 timeout);
+
+// thread safe, ends a platform_wait in progress or the next one
+AM2_API void platform_wake(void);
+
+// eventfd behind platform_wake, -1 outside platform_init/kill. Lets
+// kernel completions end a platform_wait.
+i32 platform_wake_handle(void);
+
+// confine and hide the pointer, for relative mouse look
+void platform_set_mouse_grab(platform_system_t *ps, b8 grab);
+
+// windowless backend, picked by platform_init when ps->headless is set or
+// AM2_HEADLESS is in the environment
+b8 platform_headless_init(platform_system_t *ps, const char *name, i32 width,
+                          i32 height);
+
+void platform_headless_kill(platform_system_t *ps);
+
+b8 platform_headless_pump(platform_system_t *ps);
+
+// synthetic input, queued and fed to input on the next pump of either
+// backend with the time it was injected. Main thread only, the queue
+// takes no lock; jobs hand their input to the main thread first.
+AM2_API void platform_inject_key(keys key, b8 pressed);
+
+AM2_API void platform_inject_mods(u8 mods);
+
+AM2_API void platform_inject_button(mouse_buttons button, b8 pressed);
+
+AM2_API void platform_inject_move(i16 x, i16 y);
+
+AM2_API void platform_inject_wheel(i8 z_delta);
+
+AM2_API void platform_inject_resize(u16 width, u16 height);
+
+AM2_API void platform_inject_quit(void);
+
+// feed the injected queue, false once a quit went through
+b8 platform_inject_flush(void);
+
+b8 platform_inject_pending(void);
+
 f64 platform_get_time(void);
 
+// monotonic nanoseconds, integer so long sessions keep full precision
+AM2_API u64 platform_get_time_ns(void);
+
+// Cycle counter for profiling zones, invariant TSC where the CPU has
+// one, else the nanosecond clock. Only differences are meaningful.
+AM2_API u64 platform_get_ticks(void);
+
+// ticks per second, calibrated against the monotonic clock on first use
+AM2_API u64 platform_get_tick_frequency(void);
+
+AM2_API u64 platform_ticks_to_ns(u64 ticks);
+
 void platform_sleep(u64 ms);
 
+// aligned blocks start on a PLATFORM_PAGE_SIZE boundary
 void *platform_alloc(u64 size, b8 aligned);
 
 void platform_free(void *block, b8 aligned);
 
+// Stack for a coroutine or fiber, size a multiple of PLATFORM_PAGE_SIZE.
+// A no-access guard page below the lowest byte turns an overflow into a
+// fault instead of a silent heap overwrite. Pages commit on first touch.
+void *platform_stack_alloc(u64 size);
+
+void platform_stack_free(void *stack, u64 size);
+
 void *platform_memzero(void *block, u64 size);
 
 void *platform_memcopy(void *dest, const void *src, u64 size);
@@ -30,4 +97,257 @@ void *platform_memmove(void *dest, const void *src, u64 size);
 
 void *platform_memsets(void *dest, i32 value, u64 size);
 
+/**********************************
+ * Files
+ * ********************************/
+// FILE_DIRECT reads need buffer, offset and size aligned to this
+#define PLATFORM_PAGE_SIZE 4096
+
+typedef enum {
+    FILE_DIRECT = 1 << 0, // O_DIRECT, bypass the page cache
+} platform_file_flag_t;
+
+// read only, -1 on failure
+AM2_API i32 platform_file_open(const char *path, u32 flags);
+
+AM2_API void platform_file_close(i32 file);
+
+// bytes, 0 on failure
+AM2_API u64 platform_file_size(i32 file);
+
+typedef enum {
+    FILE_MAP_SEQUENTIAL = 1 << 0, // read front to back, deep readahead
+    FILE_MAP_RANDOM = 1 << 1,     // scattered lookups, no readahead
+    FILE_MAP_WILLNEED = 1 << 2,   // start reading the whole file in now
+    FILE_MAP_PREFETCH = 1 << 3,   // fault every page in off the main thread
+} platform_file_map_flag_t;
+
+// Read only view of a whole file, shared with the page cache, 0 on
+// failure or for an empty file. Pages load on first touch unless
+// prefetched. Main thread only.
+AM2_API const void *platform_file_map(const char *path, u32 flags,
+                                      u64 *size);
+
+AM2_API void platform_file_unmap(const void *data, u64 size);
+
+// new access hint for part of a view, the range widens to whole pages
+AM2_API void platform_file_advise(const void *data, u64 offset, u64 size,
+                                  u32 flags);
+
+// stops the prefetch thread, platform_kill calls it
+void platform_file_kill(void);
+
+typedef struct {
+    u64 user;   // as given to platform_io_read
+    i64 result; // bytes read, negative errno on failure
+} platform_io_result_t;
+
+// io_uring where the kernel allows it, else pread on worker threads.
+// AM2_NO_IO_URING in the environment forces the fallback.
+b8 platform_io_init(u32 depth);
+
+void platform_io_kill(void);
+
+// Queue a read, the kernel sees nothing before platform_io_submit.
+// False while depth reads are queued or in flight.
+b8 platform_io_read(i32 file, void *buffer, u64 size, u64 offset, u64 user);
+
+// hand every queued read over in a single call
+void platform_io_submit(void);
+
+// collect finished reads, never blocks
+u32 platform_io_poll(platform_io_result_t *out, u32 max);
+
+/**********************************
+ * CPU
+ * ********************************/
+typedef enum {
+    CPU_SSE2 = 1 << 0,
+    CPU_SSE42 = 1 << 1,
+    CPU_POPCNT = 1 << 2,
+    CPU_AVX = 1 << 3,
+    CPU_AVX2 = 1 << 4,
+    CPU_FMA = 1 << 5,
+    CPU_BMI1 = 1 << 6,
+    CPU_BMI2 = 1 << 7,
+    CPU_AVX512F = 1 << 8,
+    CPU_AVX512BW = 1 << 9,
+    CPU_AVX512VL = 1 << 10,
+    CPU_INVARIANT_TSC = 1 << 11,
+} cpu_feature_t;
+
+typedef struct {
+    char vendor[13];
+    char brand[49];
+    u32 features; // cpu_feature_t bits the OS also enabled
+
+    u32 logical_cores;
+    u32 physical_cores;
+    u32 threads_per_core;
+
+    // bytes, 0 when the kernel does not report the level
+    u32 cache_line;
+    u32 l1d_size;
+    u32 l2_size;
+    u32 l3_size;
+} platform_cpu_info_t;
+
+// detected and logged on first call, constant after
+AM2_API const platform_cpu_info_t *platform_get_cpu_info(void);
+
+AM2_API b8 platform_cpu_has(cpu_feature_t feature);
+
+/**********************************
+ * Threads
+ * ********************************/
+typedef void (*platform_thread_fn)(void *arg);
+
+typedef struct {
+    u64 handle;
+    b8 valid;
+} platform_thread_t;
+
+// name shows up in debuggers and top, truncated to 15 characters
+AM2_API b8 platform_thread_create(platform_thread_t *thread,
+                                  platform_thread_fn fn, void *arg,
+                                  const char *name);
+
+AM2_API void platform_thread_join(platform_thread_t *thread);
+
+// pin to one logical cpu, false if the OS refused
+AM2_API b8 platform_thread_set_affinity(platform_thread_t *thread, u32 cpu);
+
+AM2_API b8 platform_thread_pin_current(u32 cpu);
+
+AM2_API u64 platform_thread_id(void);
+
+AM2_API void platform_thread_yield(void);
+
+// logical cpus online
+AM2_API u32 platform_get_processor_count(void);
+
+/**********************************
+ * Synchronization
+ * ********************************/
+// storage for the OS object, no allocation behind it
+typedef struct {
+    ALIGN(8) u8 data[64];
+} platform_mutex_t;
+
+typedef struct {
+    ALIGN(8) u8 data[64];
+} platform_condvar_t;
+
+AM2_API b8 platform_mutex_create(platform_mutex_t *mutex);
+
+AM2_API void platform_mutex_destroy(platform_mutex_t *mutex);
+
+AM2_API void platform_mutex_lock(platform_mutex_t *mutex);
+
+AM2_API b8 platform_mutex_try_lock(platform_mutex_t *mutex);
+
+AM2_API void platform_mutex_unlock(platform_mutex_t *mutex);
+
+AM2_API b8 platform_condvar_create(platform_condvar_t *cond);
+
+AM2_API void platform_condvar_destroy(platform_condvar_t *cond);
+
+// mutex must be held, spurious wakeups happen, recheck the predicate
+AM2_API void platform_condvar_wait(platform_condvar_t *cond,
+                                   platform_mutex_t *mutex);
+
+// false on timeout, seconds on the monotonic clock
+AM2_API b8 platform_condvar_wait_timeout(platform_condvar_t *cond,
+                                         platform_mutex_t *mutex,
+                                         f64 seconds);
+
+AM2_API void platform_condvar_signal(platform_condvar_t *cond);
+
+AM2_API void platform_condvar_broadcast(platform_condvar_t *cond);
+
+// counting semaphore, uncontended post and wait never enter the kernel
+typedef struct {
+    ALIGN(4) u32 count;
+    u32 waiters;
+} platform_semaphore_t;
+
+AM2_API void platform_semaphore_init(platform_semaphore_t *sem, u32 count);
+
+AM2_API void platform_semaphore_post(platform_semaphore_t *sem, u32 count);
+
+AM2_API void platform_semaphore_wait(platform_semaphore_t *sem);
+
+AM2_API b8 platform_semaphore_try_wait(platform_semaphore_t *sem);
+
+/**********************************
+ * Atomics
+ * ********************************/
+// C11 memory orders over the compiler builtins, the engine stays C99
+typedef enum {
+    ATOMIC_RELAXED = __ATOMIC_RELAXED,
+    ATOMIC_ACQUIRE = __ATOMIC_ACQUIRE,
+    ATOMIC_RELEASE = __ATOMIC_RELEASE,
+    ATOMIC_ACQ_REL = __ATOMIC_ACQ_REL,
+    ATOMIC_SEQ_CST = __ATOMIC_SEQ_CST,
+} atomic_order_t;
+
+#define ATOMIC_DEFINE(type, name)                                             \
+    static INL type atomic_load_##name(type *p, atomic_order_t o)             \
+    {                                                                         \
+        return __atomic_load_n(p, (int)o);                                    \
+    }                                                                         \
+    static INL void atomic_store_##name(type *p, type v, atomic_order_t o)    \
+    {                                                                         \
+        __atomic_store_n(p, v, (int)o);                                       \
+    }                                                                         \
+    static INL type atomic_exchange_##name(type *p, type v, atomic_order_t o) \
+    {                                                                         \
+        return __atomic_exchange_n(p, v, (int)o);                             \
+    }                                                                         \
+    /* on failure expected receives the current value */                      \
+    static INL b8 atomic_cas_##name(type *p, type *expected, type desired,    \
+                                    atomic_order_t o)                         \
+    {                                                                         \
+        return __atomic_compare_exchange_n(p, expected, desired, false,       \
+                                           (int)o, __ATOMIC_RELAXED);         \
+    }
+
+ATOMIC_DEFINE(u32, u32)
+ATOMIC_DEFINE(u64, u64)
+ATOMIC_DEFINE(void *, ptr)
+
+// returns the value before the add
+static INL u32 atomic_add_u32(u32 *p, u32 v, atomic_order_t o)
+{
+    return __atomic_fetch_add(p, v, (int)o);
+}
+
+static INL u32 atomic_sub_u32(u32 *p, u32 v, atomic_order_t o)
+{
+    return __atomic_fetch_sub(p, v, (int)o);
+}
+
+static INL u64 atomic_add_u64(u64 *p, u64 v, atomic_order_t o)
+{
+    return __atomic_fetch_add(p, v, (int)o);
+}
+
+static INL u64 atomic_sub_u64(u64 *p, u64 v, atomic_order_t o)
+{
+    return __atomic_fetch_sub(p, v, (int)o);
+}
+
+static INL void atomic_fence(atomic_order_t o)
+{
+    __atomic_thread_fence((int)o);
+}
+
+// spin loop hint, lets the sibling hyperthread run
+static INL void atomic_pause(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+}
+
 #endif // PLATFORM_H
@@ -0,0 +1,695 @@
+// O_DIRECT and syscall() are GNU extensions
+#define _GNU_SOURCE
+#include "platform.h"
+
+#if PLATFORM_LINUX
+#    include <linux/io_uring.h>
+#    include <errno.h>
+#    include <fcntl.h>
+#    include <sys/mman.h>
+#    include <sys/stat.h>
+#    include <sys/syscall.h>
+#    include <sys/uio.h>
+#    include <unistd.h>
+
+#    include <stdlib.h>
+#    include <string.h>
+
+// pread is blocking, a couple of threads keep the device queue busy
+#    define IO_WORKER_COUNT 2
+#    define PREFETCH_QUEUE_SIZE 64
+
+// 5.14+, older headers lack it and older kernels answer EINVAL
+#    ifndef MADV_POPULATE_READ
+#        define MADV_POPULATE_READ 22
+#    endif
+
+typedef struct {
+    i32 file;
+    void *buffer;
+    u64 size;
+    u64 offset;
+    u64 user;
+} io_request_t;
+
+typedef struct {
+    u32 depth;
+    // queued, submitted or finished but not polled. Caps the fallback
+    // rings, and the kernel rounds ring sizes up past depth.
+    u32 in_flight;
+    b8 uring;
+
+    // io_uring, rings shared with the kernel
+    i32 ring_fd;
+    u8 *sq_ring;
+    u64 sq_ring_size;
+    u8 *cq_ring;
+    u64 cq_ring_size;
+    struct io_uring_sqe *sqes;
+    u64 sqes_size;
+    u32 *sq_head;
+    u32 *sq_tail;
+    u32 *sq_array;
+    u32 sq_mask;
+    u32 *cq_head;
+    u32 *cq_tail;
+    struct io_uring_cqe *cqes;
+    u32 cq_mask;
+    u32 sq_local_tail;
+    // IORING_OP_READ is 5.6+, older kernels get READV and an iovec per
+    // sqe slot, the kernel copies it before the slot is handed back
+    b8 op_read;
+    struct iovec *iovecs;
+
+    // fallback, staged reads become visible to workers on submit
+    platform_thread_t workers[IO_WORKER_COUNT];
+    platform_mutex_t lock;
+    platform_condvar_t cond;
+    io_request_t *staged;
+    u32 staged_count;
+    io_request_t *queue;
+    u32 queue_head;
+    u32 queue_count;
+    platform_io_result_t *done;
+    u32 done_head;
+    u32 done_count;
+    b8 quit;
+} io_system_t;
+
+static b8 initialized = false;
+static io_system_t g_io = {0};
+
+typedef struct {
+    const void *data;
+    u64 size;
+    i32 file; // dup, closed once the range is in
+} prefetch_t;
+
+typedef struct {
+    platform_thread_t thread;
+    platform_mutex_t lock;
+    platform_condvar_t cond;
+    prefetch_t queue[PREFETCH_QUEUE_SIZE];
+    u32 head;
+    u32 count;
+    b8 running;
+    b8 quit;
+} prefetch_system_t;
+
+static prefetch_system_t g_prefetch = {0};
+
+i32 platform_file_open(const char *path, u32 flags)
+{
+    i32 mode = O_RDONLY | O_CLOEXEC;
+    if (flags & FILE_DIRECT) mode |= O_DIRECT;
+
+    i32 file = open(path, mode);
+    if (file < 0) LOGE("Failed to open '%s': %s", path, strerror(errno));
+    return file;
+}
+
+void platform_file_close(i32 file)
+{
+    if (file >= 0) close(file);
+}
+
+u64 platform_file_size(i32 file)
+{
+    struct stat st;
+    if (fstat(file, &st) != 0) return 0;
+    return (u64)st.st_size;
+}
+
+/**********************************
+ * Mapped views
+ * ********************************/
+// The view may be unmapped, and its range even reused, before this
+// runs. Populating then fails or prefaults someone else's pages, both
+// harmless, which is why nothing here touches the memory directly.
+static void prefetch_range(const prefetch_t *req)
+{
+    // faults the pages straight into the view's page tables
+    if (madvise((void *)(uptr)req->data, req->size, MADV_POPULATE_READ) == 0)
+        return;
+    if (errno != EINVAL) return;
+
+    // older kernels: a throwaway populated mapping pulls the file into
+    // the page cache, touches on the view then only take minor faults
+    void *tmp = mmap(0, req->size, PROT_READ, MAP_PRIVATE | MAP_POPULATE,
+                     req->file, 0);
+    if (tmp != MAP_FAILED) munmap(tmp, req->size);
+}
+
+static void prefetch_worker(void *arg)
+{
+    (void)arg;
+
+    platform_mutex_lock(&g_prefetch.lock);
+    for (;;)
+    {
+        while (!g_prefetch.quit && g_prefetch.count == 0)
+            platform_condvar_wait(&g_prefetch.cond, &g_prefetch.lock);
+        if (g_prefetch.quit) break;
+
+        prefetch_t req = g_prefetch.queue[g_prefetch.head];
+        g_prefetch.head = (g_prefetch.head + 1) % PREFETCH_QUEUE_SIZE;
+        g_prefetch.count--;
+        platform_mutex_unlock(&g_prefetch.lock);
+
+        prefetch_range(&req);
+        close(req.file);
+
+        platform_mutex_lock(&g_prefetch.lock);
+    }
+
+    // dropped requests still own their descriptor
+    while (g_prefetch.count)
+    {
+        close(g_prefetch.queue[g_prefetch.head].file);
+        g_prefetch.head = (g_prefetch.head + 1) % PREFETCH_QUEUE_SIZE;
+        g_prefetch.count--;
+    }
+    platform_mutex_unlock(&g_prefetch.lock);
+}
+
+static b8 prefetch_queue(const void *data, u64 size, i32 file)
+{
+    if (!g_prefetch.running)
+    {
+        platform_mutex_create(&g_prefetch.lock);
+        platform_condvar_create(&g_prefetch.cond);
+        g_prefetch.quit = false;
+        g_prefetch.running = platform_thread_create(
+            &g_prefetch.thread, prefetch_worker, 0, "am2-prefetch");
+        if (!g_prefetch.running)
+        {
+            platform_condvar_destroy(&g_prefetch.cond);
+            platform_mutex_destroy(&g_prefetch.lock);
+            return false;
+        }
+    }
+
+    i32 copy = dup(file);
+    if (copy < 0) return false;
+
+    platform_mutex_lock(&g_prefetch.lock);
+    b8 queued = g_prefetch.count < PREFETCH_QUEUE_SIZE;
+    if (queued)
+    {
+        u32 slot = (g_prefetch.head + g_prefetch.count) % PREFETCH_QUEUE_SIZE;
+        g_prefetch.queue[slot].data = data;
+        g_prefetch.queue[slot].size = size;
+        g_prefetch.queue[slot].file = copy;
+        g_prefetch.count++;
+        platform_condvar_signal(&g_prefetch.cond);
+    }
+    platform_mutex_unlock(&g_prefetch.lock);
+
+    if (!queued) close(copy);
+    return queued;
+}
+
+static i32 map_advice(u32 flags)
+{
+    if (flags & FILE_MAP_SEQUENTIAL) return MADV_SEQUENTIAL;
+    if (flags & FILE_MAP_RANDOM) return MADV_RANDOM;
+    return MADV_NORMAL;
+}
+
+const void *platform_file_map(const char *path, u32 flags, u64 *size)
+{
+    *size = 0;
+
+    i32 file = platform_file_open(path, 0);
+    if (file < 0) return 0;
+
+    u64 length = platform_file_size(file);
+    if (length == 0)
+    {
+        // mmap refuses zero lengths
+        LOGW("Not mapping '%s', the file is empty", path);
+        close(file);
+        return 0;
+    }
+
+    void *data = mmap(0, length, PROT_READ, MAP_PRIVATE, file, 0);
+    if (data == MAP_FAILED)
+    {
+        LOGE("Failed to map '%s': %s", path, strerror(errno));
+        close(file);
+        return 0;
+    }
+
+    i32 advice = map_advice(flags);
+    if (advice != MADV_NORMAL) madvise(data, length, advice);
+
+    // a full prefetch queue degrades to async readahead
+    if ((flags & FILE_MAP_PREFETCH) && !prefetch_queue(data, length, file))
+        flags |= FILE_MAP_WILLNEED;
+    if (flags & FILE_MAP_WILLNEED) madvise(data, length, MADV_WILLNEED);
+
+    // the mapping holds its own reference to the file
+    close(file);
+
+    *size = length;
+    return data;
+}
+
+void platform_file_unmap(const void *data, u64 size)
+{
+    if (!data) return;
+    munmap((void *)(uptr)data, size);
+}
+
+void platform_file_advise(const void *data, u64 offset, u64 size,
+                          u32 flags)
+{
+    if (!data || !size) return;
+
+    uptr start = (uptr)data + offset;
+    uptr end = start + size;
+    start &= ~(uptr)(PLATFORM_PAGE_SIZE - 1);
+
+    void *range = (void *)start;
+    u64 length = (u64)(end - start);
+    madvise(range, length, map_advice(flags));
+    if (flags & FILE_MAP_WILLNEED) madvise(range, length, MADV_WILLNEED);
+}
+
+void platform_file_kill(void)
+{
+    if (!g_prefetch.running) return;
+
+    platform_mutex_lock(&g_prefetch.lock);
+    g_prefetch.quit = true;
+    platform_condvar_broadcast(&g_prefetch.cond);
+    platform_mutex_unlock(&g_prefetch.lock);
+
+    platform_thread_join(&g_prefetch.thread);
+    platform_condvar_destroy(&g_prefetch.cond);
+    platform_mutex_destroy(&g_prefetch.lock);
+    g_prefetch.running = false;
+}
+
+/**********************************
+ * io_uring
+ * ********************************/
+static b8 uring_init(u32 depth)
+{
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+
+    // seccomp in containers often answers ENOSYS or EPERM here
+    i32 fd = (i32)syscall(__NR_io_uring_setup, depth, &params);
+    if (fd < 0)
+    {
+        LOGW("io_uring unavailable: %s", strerror(errno));
+        return false;
+    }
+    g_io.ring_fd = fd;
+
+    g_io.sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(u32);
+    g_io.cq_ring_size = params.cq_off.cqes +
+                        params.cq_entries * sizeof(struct io_uring_cqe);
+
+    // 5.4+ maps both rings through one region
+    b8 single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single && g_io.cq_ring_size > g_io.sq_ring_size)
+        g_io.sq_ring_size = g_io.cq_ring_size;
+
+    void *sq = mmap(0, g_io.sq_ring_size, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (sq == MAP_FAILED) goto fail;
+    g_io.sq_ring = (u8 *)sq;
+
+    if (single)
+    {
+        g_io.cq_ring = g_io.sq_ring;
+    }
+    else
+    {
+        void *cq = mmap(0, g_io.cq_ring_size, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if (cq == MAP_FAILED) goto fail;
+        g_io.cq_ring = (u8 *)cq;
+    }
+
+    g_io.sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    void *sqes = mmap(0, g_io.sqes_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) goto fail;
+    g_io.sqes = (struct io_uring_sqe *)sqes;
+
+    g_io.sq_head = (u32 *)(g_io.sq_ring + params.sq_off.head);
+    g_io.sq_tail = (u32 *)(g_io.sq_ring + params.sq_off.tail);
+    g_io.sq_array = (u32 *)(g_io.sq_ring + params.sq_off.array);
+    g_io.sq_mask = *(u32 *)(g_io.sq_ring + params.sq_off.ring_mask);
+    g_io.cq_head = (u32 *)(g_io.cq_ring + params.cq_off.head);
+    g_io.cq_tail = (u32 *)(g_io.cq_ring + params.cq_off.tail);
+    g_io.cqes = (struct io_uring_cqe *)(g_io.cq_ring + params.cq_off.cqes);
+    g_io.cq_mask = *(u32 *)(g_io.cq_ring + params.cq_off.ring_mask);
+    g_io.sq_local_tail = *g_io.sq_tail;
+
+    g_io.op_read = (params.features & IORING_FEAT_RW_CUR_POS) != 0;
+    if (!g_io.op_read)
+    {
+        g_io.iovecs = malloc(params.sq_entries * sizeof(struct iovec));
+        if (!g_io.iovecs) goto fail;
+    }
+
+    // completions bump the wake eventfd, so an idle platform_wait ends
+    i32 wake = platform_wake_handle();
+    if (wake >= 0 &&
+        syscall(__NR_io_uring_register, fd, IORING_REGISTER_EVENTFD, &wake,
+                1) != 0)
+    {
+        LOGW("io_uring eventfd not registered: %s", strerror(errno));
+    }
+
+    LOGI("File IO: io_uring, %u entries%s", params.sq_entries,
+         g_io.op_read ? "" : ", readv");
+    return true;
+
+fail:
+    LOGW("io_uring ring setup failed: %s", strerror(errno));
+    if (g_io.sqes) munmap(g_io.sqes, g_io.sqes_size);
+    if (g_io.sq_ring) munmap(g_io.sq_ring, g_io.sq_ring_size);
+    if (g_io.cq_ring && g_io.cq_ring != g_io.sq_ring)
+        munmap(g_io.cq_ring, g_io.cq_ring_size);
+    close(fd);
+    g_io.sqes = 0;
+    g_io.sq_ring = 0;
+    g_io.cq_ring = 0;
+    g_io.ring_fd = -1;
+    return false;
+}
+
+static void uring_read(const io_request_t *req)
+{
+    u32 index = g_io.sq_local_tail & g_io.sq_mask;
+    struct io_uring_sqe *sqe = &g_io.sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+
+    sqe->fd = req->file;
+    sqe->off = req->offset;
+    sqe->user_data = req->user;
+    if (g_io.op_read)
+    {
+        sqe->opcode = IORING_OP_READ;
+        sqe->addr = (u64)(uptr)req->buffer;
+        sqe->len = (u32)req->size;
+    }
+    else
+    {
+        g_io.iovecs[index].iov_base = req->buffer;
+        g_io.iovecs[index].iov_len = req->size;
+        sqe->opcode = IORING_OP_READV;
+        sqe->addr = (u64)(uptr)&g_io.iovecs[index];
+        sqe->len = 1;
+    }
+
+    g_io.sq_array[index] = index;
+    g_io.sq_local_tail++;
+    atomic_store_u32(g_io.sq_tail, g_io.sq_local_tail, ATOMIC_RELEASE);
+}
+
+static void uring_submit(void)
+{
+    // without SQPOLL the kernel head only moves inside io_uring_enter
+    u32 count = g_io.sq_local_tail - atomic_load_u32(g_io.sq_head,
+                                                     ATOMIC_ACQUIRE);
+    while (count)
+    {
+        long done =
+            syscall(__NR_io_uring_enter, g_io.ring_fd, count, 0, 0, 0, 0);
+        if (done < 0)
+        {
+            if (errno == EINTR) continue;
+            // EAGAIN / EBUSY: the sqes stay queued for the next submit
+            if (errno != EAGAIN && errno != EBUSY)
+                LOGE("io_uring_enter: %s", strerror(errno));
+            return;
+        }
+        if (done == 0) return;
+        count -= (u32)done;
+    }
+}
+
+static u32 uring_poll(platform_io_result_t *out, u32 max)
+{
+    u32 head = atomic_load_u32(g_io.cq_head, ATOMIC_RELAXED);
+    u32 tail = atomic_load_u32(g_io.cq_tail, ATOMIC_ACQUIRE);
+
+    u32 count = 0;
+    while (head != tail && count < max)
+    {
+        struct io_uring_cqe *cqe = &g_io.cqes[head & g_io.cq_mask];
+        out[count].user = cqe->user_data;
+        out[count].result = cqe->res;
+        count++;
+        head++;
+    }
+    atomic_store_u32(g_io.cq_head, head, ATOMIC_RELEASE);
+    return count;
+}
+
+static void uring_kill(void)
+{
+    // The kernel tears the ring down after close on its own time, reads
+    // it already took could still land in freed buffers. Reap them all
+    // first; sqes never entered are unseen and just dropped.
+    u32 unsent = g_io.sq_local_tail - atomic_load_u32(g_io.sq_head,
+                                                      ATOMIC_ACQUIRE);
+    u32 pending = g_io.in_flight - unsent;
+    while (pending)
+    {
+        platform_io_result_t results[16];
+        u32 count = uring_poll(results, 16);
+        pending -= count < pending ? count : pending;
+        if (count || !pending) continue;
+
+        long got = syscall(__NR_io_uring_enter, g_io.ring_fd, 0, 1,
+                           IORING_ENTER_GETEVENTS, 0, 0);
+        if (got < 0 && errno != EINTR)
+        {
+            LOGE("io_uring_enter: %s, %u reads not reaped", strerror(errno),
+                 pending);
+            break;
+        }
+    }
+    g_io.in_flight = 0;
+
+    munmap(g_io.sqes, g_io.sqes_size);
+    if (g_io.cq_ring != g_io.sq_ring) munmap(g_io.cq_ring, g_io.cq_ring_size);
+    munmap(g_io.sq_ring, g_io.sq_ring_size);
+    close(g_io.ring_fd);
+    free(g_io.iovecs);
+}
+
+/**********************************
+ * pread fallback
+ * ********************************/
+static i64 read_full(const io_request_t *req)
+{
+    u64 total = 0;
+    while (total < req->size)
+    {
+        ssize_t got = pread(req->file, (u8 *)req->buffer + total,
+                            req->size - total, (off_t)(req->offset + total));
+        if (got < 0)
+        {
+            if (errno == EINTR) continue;
+            return -(i64)errno;
+        }
+        if (got == 0) break; // end of file
+        total += (u64)got;
+    }
+    return (i64)total;
+}
+
+static void io_worker(void *arg)
+{
+    (void)arg;
+
+    platform_mutex_lock(&g_io.lock);
+    for (;;)
+    {
+        while (!g_io.quit && g_io.queue_count == 0)
+            platform_condvar_wait(&g_io.cond, &g_io.lock);
+        if (g_io.quit) break;
+
+        io_request_t req = g_io.queue[g_io.queue_head];
+        g_io.queue_head = (g_io.queue_head + 1) % g_io.depth;
+        g_io.queue_count--;
+        platform_mutex_unlock(&g_io.lock);
+
+        platform_io_result_t result;
+        result.user = req.user;
+        result.result = read_full(&req);
+
+        platform_mutex_lock(&g_io.lock);
+        // in_flight caps every ring at depth, this never overflows
+        u32 slot = (g_io.done_head + g_io.done_count) % g_io.depth;
+        g_io.done[slot] = result;
+        g_io.done_count++;
+        platform_wake();
+    }
+    platform_mutex_unlock(&g_io.lock);
+}
+
+static void pool_kill(void)
+{
+    // reads not picked up yet are dropped, running ones finish first
+    platform_mutex_lock(&g_io.lock);
+    g_io.quit = true;
+    platform_condvar_broadcast(&g_io.cond);
+    platform_mutex_unlock(&g_io.lock);
+
+    for (u32 i = 0; i < IO_WORKER_COUNT; ++i)
+        platform_thread_join(&g_io.workers[i]);
+
+    platform_condvar_destroy(&g_io.cond);
+    platform_mutex_destroy(&g_io.lock);
+    free(g_io.staged);
+    free(g_io.queue);
+    free(g_io.done);
+}
+
+static b8 pool_init(u32 depth)
+{
+    g_io.staged = malloc(depth * sizeof(io_request_t));
+    g_io.queue = malloc(depth * sizeof(io_request_t));
+    g_io.done = malloc(depth * sizeof(platform_io_result_t));
+    if (!g_io.staged || !g_io.queue || !g_io.done)
+    {
+        LOGE("File IO queues could not be allocated");
+        free(g_io.staged);
+        free(g_io.queue);
+        free(g_io.done);
+        return false;
+    }
+    platform_mutex_create(&g_io.lock);
+    platform_condvar_create(&g_io.cond);
+
+    for (u32 i = 0; i < IO_WORKER_COUNT; ++i)
+    {
+        if (!platform_thread_create(&g_io.workers[i], io_worker, 0,
+                                    "am2-io"))
+        {
+            // joins the workers that did start
+            pool_kill();
+            return false;
+        }
+    }
+
+    LOGI("File IO: pread on %u threads", IO_WORKER_COUNT);
+    return true;
+}
+
+static void pool_submit(void)
+{
+    if (!g_io.staged_count) return;
+
+    platform_mutex_lock(&g_io.lock);
+    for (u32 i = 0; i < g_io.staged_count; ++i)
+    {
+        u32 slot = (g_io.queue_head + g_io.queue_count) % g_io.depth;
+        g_io.queue[slot] = g_io.staged[i];
+        g_io.queue_count++;
+    }
+    platform_condvar_broadcast(&g_io.cond);
+    platform_mutex_unlock(&g_io.lock);
+
+    g_io.staged_count = 0;
+}
+
+static u32 pool_poll(platform_io_result_t *out, u32 max)
+{
+    platform_mutex_lock(&g_io.lock);
+    u32 count = 0;
+    while (g_io.done_count && count < max)
+    {
+        out[count++] = g_io.done[g_io.done_head];
+        g_io.done_head = (g_io.done_head + 1) % g_io.depth;
+        g_io.done_count--;
+    }
+    platform_mutex_unlock(&g_io.lock);
+    return count;
+}
+
+/**********************************
+ * Async reads
+ * ********************************/
+b8 platform_io_init(u32 depth)
+{
+    if (initialized) return false;
+
+    memset(&g_io, 0, sizeof(g_io));
+    g_io.depth = depth ? depth : 1;
+    g_io.ring_fd = -1;
+
+    if (!getenv("AM2_NO_IO_URING") && uring_init(g_io.depth))
+    {
+        g_io.uring = true;
+    }
+    else if (!pool_init(g_io.depth))
+    {
+        return false;
+    }
+
+    initialized = true;
+    return true;
+}
+
+void platform_io_kill(void)
+{
+    if (!initialized) return;
+
+    if (g_io.uring)
+        uring_kill();
+    else
+        pool_kill();
+
+    initialized = false;
+}
+
+b8 platform_io_read(i32 file, void *buffer, u64 size, u64 offset, u64 user)
+{
+    if (!initialized || g_io.in_flight >= g_io.depth) return false;
+
+    io_request_t req;
+    req.file = file;
+    req.buffer = buffer;
+    req.size = size;
+    req.offset = offset;
+    req.user = user;
+
+    if (g_io.uring)
+        uring_read(&req);
+    else
+        g_io.staged[g_io.staged_count++] = req;
+
+    g_io.in_flight++;
+    return true;
+}
+
+void platform_io_submit(void)
+{
+    if (!initialized) return;
+
+    if (g_io.uring)
+        uring_submit();
+    else
+        pool_submit();
+}
+
+u32 platform_io_poll(platform_io_result_t *out, u32 max)
+{
+    if (!initialized) return 0;
+
+    u32 count = g_io.uring ? uring_poll(out, max) : pool_poll(out, max);
+    g_io.in_flight -= count;
+    return count;
+}
+
+#endif // PLATFORM_LINUX
@@ -0,0 +1,171 @@
+#include "platform.h"
+#include "core/event.h"
+#include "core/trace.h"
+
+#include <stdlib.h>
+
+#define INJECT_QUEUE_SIZE 1024 // must be power of two
+
+typedef struct {
+    u16 width;
+    u16 height;
+} headless_system_t;
+
+// same kinds and payload layout as a trace record
+typedef struct {
+    u8 kind; // trace_kind_t
+    u16 code;
+    f64 time;
+    event_ctx_t ctx;
+} inject_record_t;
+
+typedef struct {
+    inject_record_t queue[INJECT_QUEUE_SIZE];
+    u32 head;
+    u32 tail;
+} inject_queue_t;
+
+static inject_queue_t g_inject = {0};
+
+static void inject_push(trace_kind_t kind, u16 code, event_ctx_t ctx)
+{
+    if (g_inject.tail - g_inject.head == INJECT_QUEUE_SIZE)
+    {
+        LOGW("Inject queue full, dropped kind %u", kind);
+        return;
+    }
+
+    inject_record_t *rec =
+        &g_inject.queue[g_inject.tail & (INJECT_QUEUE_SIZE - 1)];
+    rec->kind = (u8)kind;
+    rec->code = code;
+    rec->time = platform_get_time();
+    rec->ctx = ctx;
+    g_inject.tail++;
+}
+
+void platform_inject_key(keys key, b8 pressed)
+{
+    event_ctx_t ctx = {0};
+    ctx.data.u16[0] = (u16)key;
+    ctx.data.u8[2] = pressed;
+    inject_push(TRACE_KEY, 0, ctx);
+}
+
+void platform_inject_mods(u8 mods)
+{
+    event_ctx_t ctx = {0};
+    ctx.data.u8[0] = mods;
+    inject_push(TRACE_MODS, 0, ctx);
+}
+
+void platform_inject_button(mouse_buttons button, b8 pressed)
+{
+    event_ctx_t ctx = {0};
+    ctx.data.u16[0] = (u16)button;
+    ctx.data.u8[2] = pressed;
+    inject_push(TRACE_BUTTON, 0, ctx);
+}
+
+void platform_inject_move(i16 x, i16 y)
+{
+    event_ctx_t ctx = {0};
+    ctx.data.i16[0] = x;
+    ctx.data.i16[1] = y;
+    inject_push(TRACE_MOVE, 0, ctx);
+}
+
+void platform_inject_wheel(i8 z_delta)
+{
+    event_ctx_t ctx = {0};
+    ctx.data.i32[0] = z_delta;
+    inject_push(TRACE_WHEEL, 0, ctx);
+}
+
+void platform_inject_resize(u16 width, u16 height)
+{
+    event_ctx_t ctx = {0};
+    ctx.data.u16[0] = width;
+    ctx.data.u16[1] = height;
+    inject_push(TRACE_EVENT, EV_RESIZED, ctx);
+}
+
+void platform_inject_quit(void)
+{
+    event_ctx_t ctx = {0};
+    inject_push(TRACE_EVENT, EV_APP_QUIT, ctx);
+}
+
+b8 platform_inject_flush(void)
+{
+    b8 quit = false;
+
+    while (g_inject.head != g_inject.tail)
+    {
+        inject_record_t *rec =
+            &g_inject.queue[g_inject.head & (INJECT_QUEUE_SIZE - 1)];
+        event_ctx_t ctx = rec->ctx;
+        g_inject.head++;
+
+        // input_process_* records into a trace on its own, events posted
+        // here are captured like the platform does
+        switch ((trace_kind_t)rec->kind)
+        {
+        case TRACE_KEY:
+            input_process_key((keys)ctx.data.u16[0], ctx.data.u8[2],
+                              rec->time);
+            break;
+        case TRACE_MODS: input_process_mods(ctx.data.u8[0]); break;
+        case TRACE_BUTTON:
+            input_process_mouse_button((mouse_buttons)ctx.data.u16[0],
+                                       ctx.data.u8[2], rec->time);
+            break;
+        case TRACE_MOVE:
+            input_process_mouse_move(ctx.data.i16[0], ctx.data.i16[1]);
+            break;
+        case TRACE_WHEEL:
+            input_process_mouse_wheel((i8)ctx.data.i32[0]);
+            break;
+        case TRACE_EVENT:
+            if (rec->code == EV_APP_QUIT) quit = true;
+            trace_capture(TRACE_EVENT, rec->code, ctx);
+            event_post(rec->code, 0, ctx);
+            break;
+        default: break;
+        }
+    }
+
+    return !quit;
+}
+
+b8 platform_inject_pending(void)
+{
+    return g_inject.head != g_inject.tail;
+}
+
+b8 platform_headless_init(platform_system_t *ps, const char *name, i32 width,
+                          i32 height)
+{
+    ps->internal_data = malloc(sizeof(headless_system_t));
+    headless_system_t *headless = (headless_system_t *)ps->internal_data;
+    headless->width = (u16)width;
+    headless->height = (u16)height;
+    ps->headless = true;
+
+    LOGI("Platform Headless Init: %s (%dx%d)", name, width, height);
+    return true;
+}
+
+void platform_headless_kill(platform_system_t *ps)
+{
+    free(ps->internal_data);
+    ps->internal_data = NULL;
+
+    LOGI("Platform Headless Kill");
+}
+
+b8 platform_headless_pump(platform_system_t *ps)
+{
+    (void)ps;
+    return platform_inject_flush();
+}
@@ -1,19 +1,49 @@
+// thread names, affinity and syscall() are GNU extensions
+#define _GNU_SOURCE
 #include "platform.h"
 
 #if PLATFORM_LINUX
 #    include "core/event.h"
 #    include "core/input.h"
+#    include "core/latency.h"
+#    include "core/trace.h"
 
-#    include <xcb/xcb.h> // xcb_connection_t, xcb_window_t, xcb_screen_t, xcb_atom_t
-#    include <X11/Xlib.h>     // Display, XOpenDisplay
-#    include <X11/Xlib-xcb.h> // XGetXCBConnection
-#    include <X11/XKBlib.h>
-#    include <X11/keysym.h>
+// -DAM2_HEADLESS builds without X, no headers or libraries needed
+#    if defined(AM2_HEADLESS)
+#        define PLATFORM_X11 0
+#    else
+#        define PLATFORM_X11 1
+#    endif
+
+#    if PLATFORM_X11
+#        include <xcb/xcb.h> // xcb_connection_t, xcb_window_t, xcb_screen_t, xcb_atom_t
+#        include <X11/Xlib.h>     // Display, XOpenDisplay
+#        include <X11/Xlib-xcb.h> // XGetXCBConnection
+#        include <X11/extensions/XInput2.h>
+#        include <X11/keysym.h>
+#    endif
+#    include <linux/futex.h>
+#    include <poll.h>
+#    include <pthread.h>
+#    include <sched.h>
+#    include <sys/eventfd.h>
+#    include <sys/mman.h>
+#    include <sys/syscall.h>
 #    include <sys/time.h>
+#    include <unistd.h>
 
+#    include <stdio.h>
 #    include <stdlib.h>
 #    include <string.h>
 
+#    if defined(__x86_64__)
+#        include <cpuid.h>
+#    endif
+
+// eventfd platform_wake writes to, shared by both backends
+static i32 g_wake_fd = -1;
+
+#    if PLATFORM_X11
 typedef struct {
     Display *display;
     xcb_connection_t *conn;
@@ -21,18 +51,204 @@ typedef struct {
     xcb_window_t window;
     xcb_atom_t wm_proto;
     xcb_atom_t wm_delete;
+
+    // xcb_keycode_t -> keys, rebuilt on keyboard mapping changes
+    u8 keymap[256];
+
+    // local - server clock, in seconds
+    f64 time_offset;
+    xcb_timestamp_t last_server_time;
+    b8 time_synced;
+
+    // XInput2 raw motion, falls back to core motion deltas without it
+    i32 xi_opcode;
+    b8 xi_raw;
+    i16 last_x, last_y;
+    b8 has_last_pos;
+
+    b8 grabbed;
+    b8 focused; // FocusIn/FocusOut, gates the root window raw motion
+    xcb_cursor_t blank_cursor;
+
+    // read off the connection by platform_wait, pumped first
+    xcb_generic_event_t *stashed;
 } linux_system_t;
 
+// XIRawEvent as xcb hands it over, the 32 byte wire header plus the
+// full_sequence xcb inserts before the variable part
+typedef struct {
+    u8 response_type;
+    u8 extension;
+    u16 sequence;
+    u32 length;
+    u16 event_type;
+    u16 deviceid;
+    u32 time;
+    u32 detail;
+    u16 sourceid;
+    u16 valuators_len; // mask length in 4 byte units
+    u32 flags;
+    u32 pad;
+    u32 full_sequence;
+} xi_raw_event_t;
+
+// FP3232 as sent on the wire
+typedef struct {
+    i32 integral;
+    u32 frac;
+} xi_fp3232_t;
+
 static keys translate_keycode(u32 keycode);
 
+static void setup_raw_motion(linux_system_t *linux)
+{
+    i32 event_base = 0;
+    i32 error_base = 0;
+    if (!XQueryExtension(linux->display, "XInputExtension", &linux->xi_opcode,
+                         &event_base, &error_base))
+    {
+        LOGW("XInput2 not available, using core pointer motion");
+        return;
+    }
+
+    i32 major = 2;
+    i32 minor = 0;
+    if (XIQueryVersion(linux->display, &major, &minor) != Success)
+    {
+        LOGW("XInput 2.0 not supported, using core pointer motion");
+        return;
+    }
+
+    // raw events are only delivered to the root window
+    u8 mask_bits[XIMaskLen(XI_RawMotion)] = {0};
+    XISetMask(mask_bits, XI_RawMotion);
+
+    XIEventMask mask;
+    mask.deviceid = XIAllMasterDevices;
+    mask.mask_len = sizeof(mask_bits);
+    mask.mask = mask_bits;
+
+    XISelectEvents(linux->display, linux->screen->root, &mask, 1);
+    XFlush(linux->display);
+
+    linux->xi_raw = true;
+}
+
+// sum the raw (unaccelerated) X and Y valuators of one XI_RawMotion
+static void handle_raw_motion(const xi_raw_event_t *raw)
+{
+    const u32 *mask = (const u32 *)(raw + 1);
+    u32 mask_bits = (u32)raw->valuators_len * 32;
+
+    u32 set = 0;
+    for (u32 i = 0; i < mask_bits; ++i)
+    {
+        if (mask[i >> 5] & (1u << (i & 31))) set++;
+    }
+
+    // accelerated values come first, raw values follow
+    const xi_fp3232_t *accel =
+        (const xi_fp3232_t *)(mask + raw->valuators_len);
+    const xi_fp3232_t *value = accel + set;
+
+    f64 delta[2] = {0.0, 0.0};
+    for (u32 i = 0, n = 0; i < mask_bits && i < 2; ++i)
+    {
+        if (!(mask[i >> 5] & (1u << (i & 31)))) continue;
+
+        delta[i] = (f64)value[n].integral + (f64)value[n].frac / 4294967296.0;
+        n++;
+    }
+
+    if (delta[0] != 0.0 || delta[1] != 0.0)
+    {
+        input_process_mouse_raw(delta[0], delta[1]);
+    }
+}
+
+// X server time is in milliseconds on its own clock. An event can only
+// arrive after it happened, so the smallest local - server difference
+// seen so far is the best offset estimate. Resync when the server clock
+// wraps (~49 days) or jumps.
+static f64 server_time_to_local(linux_system_t *linux, xcb_timestamp_t ms)
+{
+    f64 now = platform_get_time();
+    f64 offset = now - (f64)ms / 1000.0;
+
+    if (!linux->time_synced || ms < linux->last_server_time ||
+        offset < linux->time_offset || offset > linux->time_offset + 1.0)
+    {
+        linux->time_offset = offset;
+        linux->time_synced = true;
+    }
+    linux->last_server_time = ms;
+
+    // relative to the fastest delivery seen, so this is queueing delay
+    // in the server, socket and our pump on top of the best case
+    f64 local = (f64)ms / 1000.0 + linux->time_offset;
+    latency_sample(LATENCY_ARRIVAL, local, now);
+
+    return local;
+}
+
+static void build_keymap(linux_system_t *linux)
+{
+    i32 min_code = 0;
+    i32 max_code = 0;
+    i32 syms_per_code = 0;
+
+    // whole keyboard in one request, first keysym per code is what
+    // XkbKeycodeToKeysym(display, code, 0, 0) used to return
+    XDisplayKeycodes(linux->display, &min_code, &max_code);
+    KeySym *syms =
+        XGetKeyboardMapping(linux->display, (KeyCode)min_code,
+                            max_code - min_code + 1, &syms_per_code);
+
+    memset(linux->keymap, KEY_UNKNOWN, sizeof(linux->keymap));
+    if (!syms)
+    {
+        LOGE("Failed to read keyboard mapping");
+        return;
+    }
+
+    for (i32 code = min_code; code <= max_code && code < 256; ++code)
+    {
+        KeySym sym = syms[(code - min_code) * syms_per_code];
+        linux->keymap[code] = (u8)translate_keycode((u32)sym);
+    }
+
+    XFree(syms);
+}
+#    endif // PLATFORM_X11
+
 b8 platform_init(platform_system_t *ps, const char *name, i32 width,
                  i32 height)
 {
+    g_wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (g_wake_fd < 0) LOGW("No eventfd, platform_wake disabled");
+
+#    if !PLATFORM_X11
+    ps->headless = true;
+    return platform_headless_init(ps, name, width, height);
+#    else
+    if (ps->headless || getenv("AM2_HEADLESS"))
+    {
+        return platform_headless_init(ps, name, width, height);
+    }
+
     ps->internal_data = malloc(sizeof(linux_system_t));
     linux_system_t *linux = (linux_system_t *)ps->internal_data;
+    memset(linux, 0, sizeof(linux_system_t));
 
     // setup for X11 server
     linux->display = XOpenDisplay(NULL);
+    if (!linux->display)
+    {
+        LOGF("Failed to open X display, set AM2_HEADLESS=1 to run without");
+        free(linux);
+        ps->internal_data = NULL;
+        return false;
+    }
     XAutoRepeatOff(linux->display);
 
     // setup for xcb
@@ -52,13 +268,15 @@ b8 platform_init(platform_system_t *ps, const char *name, i32 width,
         xcb_screen_next(&it);
     }
     linux->screen = it.data;
+
+    build_keymap(linux);
     linux->window = xcb_generate_id(linux->conn);
 
     // all mask event for xcb window
     u32 values = XCB_EVENT_MASK_EXPOSURE | XCB_EVENT_MASK_STRUCTURE_NOTIFY |
                  XCB_EVENT_MASK_POINTER_MOTION | XCB_EVENT_MASK_BUTTON_PRESS |
                  XCB_EVENT_MASK_BUTTON_RELEASE | XCB_EVENT_MASK_KEY_PRESS |
-                 XCB_EVENT_MASK_KEY_RELEASE;
+                 XCB_EVENT_MASK_KEY_RELEASE | XCB_EVENT_MASK_FOCUS_CHANGE;
     u32 value_list[] = {linux->screen->black_pixel, values};
     u32 event_mask = XCB_CW_BACK_PIXEL | XCB_CW_EVENT_MASK;
 
@@ -125,31 +343,114 @@ b8 platform_init(platform_system_t *ps, const char *name, i32 width,
         return false;
     }
 
+    setup_raw_motion(linux);
+
     LOGI("Platform Linux Init");
     return true;
+#    endif
 }
 
 void platform_kill(platform_system_t *ps)
 {
+    platform_file_kill();
+
+    if (g_wake_fd >= 0)
+    {
+        close(g_wake_fd);
+        g_wake_fd = -1;
+    }
+
+    if (ps->headless)
+    {
+        platform_headless_kill(ps);
+        return;
+    }
+
+#    if PLATFORM_X11
     linux_system_t *linux = (linux_system_t *)ps->internal_data;
+    if (!linux) return;
 
+    free(linux->stashed);
     XAutoRepeatOn(linux->display);
+    if (linux->grabbed) xcb_ungrab_pointer(linux->conn, XCB_CURRENT_TIME);
+    if (linux->blank_cursor) xcb_free_cursor(linux->conn, linux->blank_cursor);
     xcb_destroy_window(linux->conn, linux->window);
     XCloseDisplay(linux->display);
     free(linux);
     ps->internal_data = NULL;
 
     LOGI("Platform Linux Kill");
+#    endif
+}
+
+void platform_set_mouse_grab(platform_system_t *ps, b8 grab)
+{
+    if (ps->headless) return;
+
+#    if PLATFORM_X11
+    linux_system_t *linux = (linux_system_t *)ps->internal_data;
+    if (linux->grabbed == grab) return;
+
+    if (grab)
+    {
+        if (!linux->blank_cursor)
+        {
+            // 1x1 empty bitmap as cursor hides the pointer while grabbed
+            xcb_pixmap_t pixmap = xcb_generate_id(linux->conn);
+            xcb_create_pixmap(linux->conn, 1, pixmap, linux->window, 1, 1);
+
+            linux->blank_cursor = xcb_generate_id(linux->conn);
+            xcb_create_cursor(linux->conn, linux->blank_cursor, pixmap,
+                              pixmap, 0, 0, 0, 0, 0, 0, 0, 0);
+            xcb_free_pixmap(linux->conn, pixmap);
+        }
+
+        u16 mask = XCB_EVENT_MASK_POINTER_MOTION |
+                   XCB_EVENT_MASK_BUTTON_PRESS | XCB_EVENT_MASK_BUTTON_RELEASE;
+        xcb_grab_pointer_cookie_t cookie = xcb_grab_pointer(
+            linux->conn, 1, linux->window, mask, XCB_GRAB_MODE_ASYNC,
+            XCB_GRAB_MODE_ASYNC, linux->window, linux->blank_cursor,
+            XCB_CURRENT_TIME);
+
+        xcb_grab_pointer_reply_t *reply =
+            xcb_grab_pointer_reply(linux->conn, cookie, NULL);
+        if (!reply || reply->status != XCB_GRAB_STATUS_SUCCESS)
+        {
+            LOGW("Failed to grab pointer");
+            free(reply);
+            return;
+        }
+        free(reply);
+    }
+    else
+    {
+        xcb_ungrab_pointer(linux->conn, XCB_CURRENT_TIME);
+        xcb_flush(linux->conn);
+    }
+
+    linux->grabbed = grab;
+#    else
+    (void)grab;
+#    endif
 }
 
 b8 platform_pump(platform_system_t *ps)
 {
+    if (ps->headless)
+    {
+        return platform_headless_pump(ps);
+    }
+
+#    if PLATFORM_X11
+
     linux_system_t *linux = (linux_system_t *)ps->internal_data;
     xcb_generic_event_t *event;
-    b8 quit = false;
+    b8 quit = !platform_inject_flush();
 
-    while ((event = xcb_poll_for_event(linux->conn)) != NULL)
+    while ((event = linux->stashed ? linux->stashed
+                                   : xcb_poll_for_event(linux->conn)) != NULL)
     {
+        linux->stashed = NULL;
         xcb_client_message_event_t *cm;
 
         switch (event->response_type & ~0x80)
@@ -159,11 +460,9 @@ b8 platform_pump(platform_system_t *ps)
         {
             xcb_key_press_event_t *kbd_ev = (xcb_key_press_event_t *)event;
             b8 pressed = event->response_type == XCB_KEY_PRESS;
-            xcb_keycode_t code = kbd_ev->detail;
-            KeySym key_sym = XkbKeycodeToKeysym(linux->display, code, 0, 0);
-
-            keys key = translate_keycode((u32)key_sym);
-            input_process_key(key, pressed);
+            keys key = (keys)linux->keymap[kbd_ev->detail];
+            f64 time = server_time_to_local(linux, kbd_ev->time);
+            input_process_key(key, pressed, time);
 
             u8 mods = 0;
             if (kbd_ev->state & XCB_MOD_MASK_SHIFT) mods |= MOD_SHIFT;
@@ -190,7 +489,10 @@ b8 platform_pump(platform_system_t *ps)
             }
 
             if (mouse_button != MB_COUNT)
-                input_process_mouse_button(mouse_button, pressed);
+            {
+                f64 time = server_time_to_local(linux, m_ev->time);
+                input_process_mouse_button(mouse_button, pressed, time);
+            }
         }
         break;
 
@@ -199,6 +501,34 @@ b8 platform_pump(platform_system_t *ps)
             xcb_motion_notify_event_t *move_ev =
                 (xcb_motion_notify_event_t *)event;
             input_process_mouse_move(move_ev->event_x, move_ev->event_y);
+
+            if (!linux->xi_raw)
+            {
+                // no raw motion, deltas of the accelerated pointer
+                if (linux->has_last_pos)
+                {
+                    input_process_mouse_raw(
+                        (f64)(move_ev->event_x - linux->last_x),
+                        (f64)(move_ev->event_y - linux->last_y));
+                }
+                linux->last_x = move_ev->event_x;
+                linux->last_y = move_ev->event_y;
+                linux->has_last_pos = true;
+            }
+        }
+        break;
+
+        case XCB_GE_GENERIC:
+        {
+            xi_raw_event_t *raw = (xi_raw_event_t *)event;
+            // selected on the root window, so it also arrives while
+            // another window has focus, only the owner of the mouse uses it
+            if (linux->xi_raw && raw->extension == linux->xi_opcode &&
+                raw->event_type == XI_RawMotion &&
+                (linux->focused || linux->grabbed))
+            {
+                handle_raw_motion(raw);
+            }
         }
         break;
 
@@ -211,7 +541,55 @@ b8 platform_pump(platform_system_t *ps)
             c.data.u16[0] = cfg_ev->width;
             c.data.u16[1] = cfg_ev->height;
 
-            event_emit(EV_RESIZED, 0, c);
+            trace_capture(TRACE_EVENT, EV_RESIZED, c);
+            event_post(EV_RESIZED, 0, c);
+        }
+        break;
+
+        case XCB_MAP_NOTIFY:
+        case XCB_UNMAP_NOTIFY:
+        {
+            event_ctx_t c = {0};
+            c.data.u8[0] =
+                (event->response_type & ~0x80) == XCB_MAP_NOTIFY;
+
+            trace_capture(TRACE_EVENT, EV_VISIBILITY_CHANGED, c);
+            event_post(EV_VISIBILITY_CHANGED, 0, c);
+        }
+        break;
+
+        case XCB_FOCUS_IN:
+        case XCB_FOCUS_OUT:
+        {
+            xcb_focus_in_event_t *focus_ev = (xcb_focus_in_event_t *)event;
+
+            // keyboard grabs (alt-tab, WM shortcuts) bounce focus, the
+            // window never really lost it
+            if (focus_ev->mode == XCB_NOTIFY_MODE_GRAB ||
+                focus_ev->mode == XCB_NOTIFY_MODE_UNGRAB)
+            {
+                break;
+            }
+
+            linux->focused =
+                (event->response_type & ~0x80) == XCB_FOCUS_IN;
+
+            event_ctx_t c = {0};
+            c.data.u8[0] = linux->focused;
+            trace_capture(TRACE_EVENT, EV_FOCUS_CHANGED, c);
+            event_post(EV_FOCUS_CHANGED, 0, c);
+        }
+        break;
+
+        case XCB_MAPPING_NOTIFY:
+        {
+            xcb_mapping_notify_event_t *map_ev =
+                (xcb_mapping_notify_event_t *)event;
+
+            if (map_ev->request == XCB_MAPPING_KEYBOARD)
+            {
+                build_keymap(linux);
+            }
         }
         break;
 
@@ -225,7 +603,8 @@ b8 platform_pump(platform_system_t *ps)
 
                 event_ctx_t c;
                 c.data.u8[0] = (u8)cm->window;
-                event_emit(EV_APP_QUIT, 0, c);
+                trace_capture(TRACE_EVENT, EV_APP_QUIT, c);
+                event_post(EV_APP_QUIT, 0, c);
             }
         }
         break;
@@ -235,6 +614,88 @@ b8 platform_pump(platform_system_t *ps)
         free(event);
     }
     return !quit;
+#    else
+    // headless builds force ps->headless in platform_init
+    return false;
+#    endif
+}
+
+b8 platform_wait(platform_system_t *ps, f64 timeout)
+{
+    if (platform_inject_pending()) return true;
+
+    struct pollfd fds[2];
+    u32 count = 0;
+
+#    if PLATFORM_X11
+    if (!ps->headless)
+    {
+        linux_system_t *linux = (linux_system_t *)ps->internal_data;
+        if (linux->stashed) return true;
+
+        // xcb may already hold events read with a reply, poll() on the
+        // socket would not see those
+        linux->stashed = xcb_poll_for_queued_event(linux->conn);
+        if (linux->stashed) return true;
+
+        xcb_flush(linux->conn);
+        fds[count].fd = xcb_get_file_descriptor(linux->conn);
+        fds[count].events = POLLIN;
+        count++;
+    }
+#    else
+    (void)ps;
+#    endif
+
+    if (g_wake_fd >= 0)
+    {
+        fds[count].fd = g_wake_fd;
+        fds[count].events = POLLIN;
+        count++;
+    }
+    else if (count == 0 && timeout < 0.0)
+    {
+        // headless without eventfd, nothing could ever end the wait
+        return false;
+    }
+
+    // round up, waking early would only make the caller spin
+    i32 ms = -1;
+    if (timeout >= 0.0)
+    {
+        f64 ceil_ms = timeout * 1000.0;
+        ms = (i32)ceil_ms;
+        if ((f64)ms < ceil_ms) ms++;
+    }
+
+    i32 ready = poll(fds, count, ms);
+    if (ready <= 0) return false;
+
+    if (g_wake_fd >= 0 && (fds[count - 1].revents & POLLIN))
+    {
+        u64 value;
+        if (read(g_wake_fd, &value, sizeof(value)) < 0)
+        {
+            // already drained by another waiter, nothing to do
+        }
+    }
+    return true;
+}
+
+void platform_wake(void)
+{
+    if (g_wake_fd < 0) return;
+
+    u64 one = 1;
+    if (write(g_wake_fd, &one, sizeof(one)) < 0)
+    {
+        // counter full means a wake is already pending
+    }
+}
+
+i32 platform_wake_handle(void)
+{
+    return g_wake_fd;
 }
 
 f64 platform_get_time(void)
@@ -244,6 +705,83 @@ f64 platform_get_time(void)
     return (f64)now.tv_sec + (f64)now.tv_nsec * 1e-9;
 }
 
+u64 platform_get_time_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (u64)now.tv_sec * 1000000000ULL + (u64)now.tv_nsec;
+}
+
+static u64 g_tick_frequency = 0;
+static b8 g_tick_tsc = false;
+
+u64 platform_get_ticks(void)
+{
+#    if defined(__x86_64__)
+    if (g_tick_tsc) return __builtin_ia32_rdtsc();
+#    endif
+    return platform_get_time_ns();
+}
+
+// Count TSC ticks across ~10 ms of monotonic time. Each end takes the
+// clock read with the smallest rdtsc bracket, which keeps a preemption
+// between the two reads out of the result.
+static u64 tick_calibrate(void)
+{
+#    if defined(__x86_64__)
+    u64 ns[2];
+    u64 tsc[2];
+    for (u32 end = 0; end < 2; ++end)
+    {
+        if (end) platform_sleep(10);
+
+        u64 best = (u64)-1;
+        for (u32 i = 0; i < 5; ++i)
+        {
+            u64 before = __builtin_ia32_rdtsc();
+            u64 clock = platform_get_time_ns();
+            u64 after = __builtin_ia32_rdtsc();
+            if (after - before < best)
+            {
+                best = after - before;
+                ns[end] = clock;
+                tsc[end] = before + best / 2;
+            }
+        }
+    }
+
+    f64 seconds = (f64)(ns[1] - ns[0]) * 1e-9;
+    return (u64)((f64)(tsc[1] - tsc[0]) / seconds);
+#    else
+    return 0;
+#    endif
+}
+
+u64 platform_get_tick_frequency(void)
+{
+    if (g_tick_frequency) return g_tick_frequency;
+
+    // without an invariant TSC the rate follows frequency scaling
+    if (platform_cpu_has(CPU_INVARIANT_TSC))
+    {
+        g_tick_frequency = tick_calibrate();
+        g_tick_tsc = g_tick_frequency != 0;
+    }
+    if (!g_tick_tsc) g_tick_frequency = 1000000000ULL;
+
+    LOGI("Ticks: %s at %.3f MHz", g_tick_tsc ? "rdtsc" : "clock_gettime",
+         (f64)g_tick_frequency / 1e6);
+    return g_tick_frequency;
+}
+
+u64 platform_ticks_to_ns(u64 ticks)
+{
+    u64 freq = platform_get_tick_frequency();
+    // split so ticks * 1e9 cannot overflow
+    return ticks / freq * 1000000000ULL +
+           ticks % freq * 1000000000ULL / freq;
+}
+
 void platform_sleep(u64 ms)
 {
     struct timespec ts;
@@ -254,16 +792,42 @@ void platform_sleep(u64 ms)
 
 void *platform_alloc(u64 size, b8 aligned)
 {
-    (void)aligned;
-    return malloc(size);
+    if (!aligned) return malloc(size);
+
+    void *block = 0;
+    if (posix_memalign(&block, PLATFORM_PAGE_SIZE, size) != 0) return 0;
+    return block;
 }
 
 void platform_free(void *block, b8 aligned)
 {
+    // posix_memalign blocks go back through free as well
     (void)aligned;
     free(block);
 }
 
+void *platform_stack_alloc(u64 size)
+{
+    u64 total = size + PLATFORM_PAGE_SIZE;
+    void *base = mmap(0, total, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+    if (base == MAP_FAILED) return 0;
+
+    // stacks grow down, the guard goes below the lowest address
+    if (mprotect(base, PLATFORM_PAGE_SIZE, PROT_NONE) != 0)
+    {
+        munmap(base, total);
+        return 0;
+    }
+    return (u8 *)base + PLATFORM_PAGE_SIZE;
+}
+
+void platform_stack_free(void *stack, u64 size)
+{
+    if (!stack) return;
+    munmap((u8 *)stack - PLATFORM_PAGE_SIZE, size + PLATFORM_PAGE_SIZE);
+}
+
 void *platform_memzero(void *block, u64 size)
 {
     return memset(block, 0, size);
@@ -284,6 +848,406 @@ void *platform_memsets(void *dest, i32 value, u64 size)
     return memset(dest, value, size);
 }
 
+static b8 g_cpu_detected = false;
+static platform_cpu_info_t g_cpu = {0};
+
+// first number in a sysfs file, with the K/M suffix cache sizes use
+static u32 sys_read_u32(const char *path)
+{
+    FILE *file = fopen(path, "r");
+    if (!file) return 0;
+
+    char line[64] = {0};
+    char *ok = fgets(line, sizeof(line), file);
+    fclose(file);
+    if (!ok) return 0;
+
+    char *end = line;
+    unsigned long value = strtoul(line, &end, 10);
+    if (*end == 'K') value *= 1024;
+    if (*end == 'M') value *= 1024 * 1024;
+    return (u32)value;
+}
+
+// entries in a cpu list like "0-3,8-11"
+static u32 sys_count_cpu_list(const char *path)
+{
+    FILE *file = fopen(path, "r");
+    if (!file) return 0;
+
+    char line[256] = {0};
+    char *ok = fgets(line, sizeof(line), file);
+    fclose(file);
+    if (!ok) return 0;
+
+    u32 count = 0;
+    char *cursor = line;
+    while (*cursor >= '0' && *cursor <= '9')
+    {
+        unsigned long first = strtoul(cursor, &cursor, 10);
+        unsigned long last = first;
+        if (*cursor == '-') last = strtoul(cursor + 1, &cursor, 10);
+        count += (u32)(last - first + 1);
+        if (*cursor == ',') cursor++;
+    }
+    return count;
+}
+
+static void cpu_detect_topology(platform_cpu_info_t *cpu)
+{
+    cpu->logical_cores = platform_get_processor_count();
+
+    const char *base = "/sys/devices/system/cpu/cpu0";
+    char path[128];
+
+    snprintf(path, sizeof(path), "%s/topology/thread_siblings_list", base);
+    cpu->threads_per_core = sys_count_cpu_list(path);
+    if (cpu->threads_per_core == 0) cpu->threads_per_core = 1;
+    cpu->physical_cores = cpu->logical_cores / cpu->threads_per_core;
+    if (cpu->physical_cores == 0) cpu->physical_cores = 1;
+
+    // index0.. are the caches cpu0 sees, instruction caches skipped
+    for (u32 i = 0; i < 8; ++i)
+    {
+        snprintf(path, sizeof(path), "%s/cache/index%u/type", base, i);
+        FILE *file = fopen(path, "r");
+        if (!file) break;
+
+        char type[32] = {0};
+        char *ok = fgets(type, sizeof(type), file);
+        fclose(file);
+        if (!ok || type[0] == 'I') continue;
+
+        snprintf(path, sizeof(path), "%s/cache/index%u/level", base, i);
+        u32 level = sys_read_u32(path);
+        snprintf(path, sizeof(path), "%s/cache/index%u/size", base, i);
+        u32 size = sys_read_u32(path);
+        snprintf(path, sizeof(path),
+                 "%s/cache/index%u/coherency_line_size", base, i);
+        u32 line = sys_read_u32(path);
+
+        if (level == 1) cpu->l1d_size = size;
+        if (level == 2) cpu->l2_size = size;
+        if (level == 3) cpu->l3_size = size;
+        if (line > cpu->cache_line) cpu->cache_line = line;
+    }
+    if (cpu->cache_line == 0) cpu->cache_line = 64;
+}
+
+#    if defined(__x86_64__)
+static void cpu_detect_features(platform_cpu_info_t *cpu)
+{
+    u32 a, b, c, d;
+    if (!__get_cpuid(0, &a, &b, &c, &d)) return;
+
+    u32 max_leaf = a;
+    memcpy(cpu->vendor + 0, &b, 4);
+    memcpy(cpu->vendor + 4, &d, 4);
+    memcpy(cpu->vendor + 8, &c, 4);
+
+    __get_cpuid(1, &a, &b, &c, &d);
+    if (d & bit_SSE2) cpu->features |= CPU_SSE2;
+    if (c & bit_SSE4_2) cpu->features |= CPU_SSE42;
+    if (c & bit_POPCNT) cpu->features |= CPU_POPCNT;
+
+    // AVX state has to be enabled by the OS, not only present
+    u64 xcr0 = 0;
+    if ((c & bit_OSXSAVE) && (c & bit_AVX))
+    {
+        u32 lo, hi;
+        __asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+        xcr0 = (u64)hi << 32 | lo;
+    }
+    b8 ymm = (xcr0 & 0x06) == 0x06;
+    b8 zmm = ymm && (xcr0 & 0xE0) == 0xE0;
+
+    if (ymm) cpu->features |= CPU_AVX;
+    if (ymm && (c & bit_FMA)) cpu->features |= CPU_FMA;
+
+    if (max_leaf >= 7)
+    {
+        __cpuid_count(7, 0, a, b, c, d);
+        if (b & bit_BMI) cpu->features |= CPU_BMI1;
+        if (b & bit_BMI2) cpu->features |= CPU_BMI2;
+        if (ymm && (b & bit_AVX2)) cpu->features |= CPU_AVX2;
+        if (zmm && (b & bit_AVX512F)) cpu->features |= CPU_AVX512F;
+        if (zmm && (b & bit_AVX512BW)) cpu->features |= CPU_AVX512BW;
+        if (zmm && (b & bit_AVX512VL)) cpu->features |= CPU_AVX512VL;
+    }
+
+    __get_cpuid(0x80000000, &a, &b, &c, &d);
+    u32 max_ext = a;
+    if (max_ext >= 0x80000004)
+    {
+        for (u32 i = 0; i < 3; ++i)
+        {
+            __get_cpuid(0x80000002 + i, &a, &b, &c, &d);
+            memcpy(cpu->brand + i * 16 + 0, &a, 4);
+            memcpy(cpu->brand + i * 16 + 4, &b, 4);
+            memcpy(cpu->brand + i * 16 + 8, &c, 4);
+            memcpy(cpu->brand + i * 16 + 12, &d, 4);
+        }
+    }
+    if (max_ext >= 0x80000007)
+    {
+        __get_cpuid(0x80000007, &a, &b, &c, &d);
+        if (d & (1u << 8)) cpu->features |= CPU_INVARIANT_TSC;
+    }
+}
+#    else
+static void cpu_detect_features(platform_cpu_info_t *cpu)
+{
+    (void)cpu;
+}
+#    endif
+
+const platform_cpu_info_t *platform_get_cpu_info(void)
+{
+    if (g_cpu_detected) return &g_cpu;
+
+    cpu_detect_features(&g_cpu);
+    cpu_detect_topology(&g_cpu);
+    g_cpu_detected = true;
+
+    // brand strings come padded with leading spaces
+    const char *brand = g_cpu.brand;
+    while (*brand == ' ')
+        brand++;
+
+    LOGI("CPU: %s (%s)", brand[0] ? brand : "unknown", g_cpu.vendor);
+    LOGI("--> %u cores, %u threads, L1d %u KiB, L2 %u KiB, L3 %u KiB",
+         g_cpu.physical_cores, g_cpu.logical_cores, g_cpu.l1d_size / 1024,
+         g_cpu.l2_size / 1024, g_cpu.l3_size / 1024);
+    LOGI("--> %s%s%s%s%s%s%s%s", g_cpu.features & CPU_SSE42 ? "sse4.2 " : "",
+         g_cpu.features & CPU_AVX ? "avx " : "",
+         g_cpu.features & CPU_AVX2 ? "avx2 " : "",
+         g_cpu.features & CPU_FMA ? "fma " : "",
+         g_cpu.features & CPU_BMI2 ? "bmi2 " : "",
+         g_cpu.features & CPU_AVX512F ? "avx512f " : "",
+         g_cpu.features & CPU_AVX512BW ? "avx512bw " : "",
+         g_cpu.features & CPU_INVARIANT_TSC ? "invariant-tsc" : "");
+    return &g_cpu;
+}
+
+b8 platform_cpu_has(cpu_feature_t feature)
+{
+    return (platform_get_cpu_info()->features & (u32)feature) ==
+           (u32)feature;
+}
+
+STATIC_ASSERT(sizeof(pthread_t) <= sizeof(u64), pthread_t_fits_handle);
+STATIC_ASSERT(sizeof(pthread_mutex_t) <= sizeof(platform_mutex_t),
+              pthread_mutex_fits);
+STATIC_ASSERT(sizeof(pthread_cond_t) <= sizeof(platform_condvar_t),
+              pthread_cond_fits);
+
+typedef struct {
+    platform_thread_fn fn;
+    void *arg;
+    char name[16];
+} thread_start_t;
+
+static void *thread_entry(void *param)
+{
+    thread_start_t start = *(thread_start_t *)param;
+    free(param);
+
+    // set from inside, the name then also covers threads that exit fast
+    if (start.name[0]) pthread_setname_np(pthread_self(), start.name);
+    start.fn(start.arg);
+    return NULL;
+}
+
+b8 platform_thread_create(platform_thread_t *thread, platform_thread_fn fn,
+                          void *arg, const char *name)
+{
+    thread_start_t *start = malloc(sizeof(thread_start_t));
+    start->fn = fn;
+    start->arg = arg;
+    start->name[0] = '\0';
+    if (name)
+    {
+        strncpy(start->name, name, sizeof(start->name) - 1);
+        start->name[sizeof(start->name) - 1] = '\0';
+    }
+
+    pthread_t handle;
+    i32 result = pthread_create(&handle, NULL, thread_entry, start);
+    if (result != 0)
+    {
+        LOGE("Failed to create thread '%s': %s", name ? name : "",
+             strerror(result));
+        free(start);
+        thread->valid = false;
+        return false;
+    }
+
+    thread->handle = (u64)handle;
+    thread->valid = true;
+    return true;
+}
+
+void platform_thread_join(platform_thread_t *thread)
+{
+    if (!thread->valid) return;
+
+    pthread_join((pthread_t)thread->handle, NULL);
+    thread->valid = false;
+}
+
+static b8 set_affinity(pthread_t handle, u32 cpu)
+{
+    if (cpu >= CPU_SETSIZE) return false;
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(handle, sizeof(set), &set) == 0;
+}
+
+b8 platform_thread_set_affinity(platform_thread_t *thread, u32 cpu)
+{
+    if (!thread->valid) return false;
+    return set_affinity((pthread_t)thread->handle, cpu);
+}
+
+b8 platform_thread_pin_current(u32 cpu)
+{
+    return set_affinity(pthread_self(), cpu);
+}
+
+u64 platform_thread_id(void)
+{
+    return (u64)syscall(SYS_gettid);
+}
+
+void platform_thread_yield(void)
+{
+    sched_yield();
+}
+
+u32 platform_get_processor_count(void)
+{
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (u32)count : 1;
+}
+
+b8 platform_mutex_create(platform_mutex_t *mutex)
+{
+    return pthread_mutex_init((pthread_mutex_t *)mutex->data, NULL) == 0;
+}
+
+void platform_mutex_destroy(platform_mutex_t *mutex)
+{
+    pthread_mutex_destroy((pthread_mutex_t *)mutex->data);
+}
+
+void platform_mutex_lock(platform_mutex_t *mutex)
+{
+    pthread_mutex_lock((pthread_mutex_t *)mutex->data);
+}
+
+b8 platform_mutex_try_lock(platform_mutex_t *mutex)
+{
+    return pthread_mutex_trylock((pthread_mutex_t *)mutex->data) == 0;
+}
+
+void platform_mutex_unlock(platform_mutex_t *mutex)
+{
+    pthread_mutex_unlock((pthread_mutex_t *)mutex->data);
+}
+
+b8 platform_condvar_create(platform_condvar_t *cond)
+{
+    // timed waits use the same clock as platform_get_time
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    i32 result = pthread_cond_init((pthread_cond_t *)cond->data, &attr);
+    pthread_condattr_destroy(&attr);
+    return result == 0;
+}
+
+void platform_condvar_destroy(platform_condvar_t *cond)
+{
+    pthread_cond_destroy((pthread_cond_t *)cond->data);
+}
+
+void platform_condvar_wait(platform_condvar_t *cond, platform_mutex_t *mutex)
+{
+    pthread_cond_wait((pthread_cond_t *)cond->data,
+                      (pthread_mutex_t *)mutex->data);
+}
+
+b8 platform_condvar_wait_timeout(platform_condvar_t *cond,
+                                 platform_mutex_t *mutex, f64 seconds)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    i64 ns = (i64)ts.tv_nsec + (i64)(seconds * 1e9);
+    ts.tv_sec += (time_t)(ns / 1000000000);
+    ts.tv_nsec = (long)(ns % 1000000000);
+
+    return pthread_cond_timedwait((pthread_cond_t *)cond->data,
+                                  (pthread_mutex_t *)mutex->data, &ts) == 0;
+}
+
+void platform_condvar_signal(platform_condvar_t *cond)
+{
+    pthread_cond_signal((pthread_cond_t *)cond->data);
+}
+
+void platform_condvar_broadcast(platform_condvar_t *cond)
+{
+    pthread_cond_broadcast((pthread_cond_t *)cond->data);
+}
+
+void platform_semaphore_init(platform_semaphore_t *sem, u32 count)
+{
+    sem->count = count;
+    sem->waiters = 0;
+}
+
+void platform_semaphore_post(platform_semaphore_t *sem, u32 count)
+{
+    atomic_add_u32(&sem->count, count, ATOMIC_SEQ_CST);
+
+    // a waiter that registered after this load sees count > 0 in the
+    // futex compare and does not sleep
+    if (atomic_load_u32(&sem->waiters, ATOMIC_SEQ_CST))
+    {
+        syscall(SYS_futex, &sem->count, FUTEX_WAKE_PRIVATE, count, NULL,
+                NULL, 0);
+    }
+}
+
+b8 platform_semaphore_try_wait(platform_semaphore_t *sem)
+{
+    u32 count = atomic_load_u32(&sem->count, ATOMIC_RELAXED);
+    while (count > 0)
+    {
+        if (atomic_cas_u32(&sem->count, &count, count - 1, ATOMIC_ACQUIRE))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void platform_semaphore_wait(platform_semaphore_t *sem)
+{
+    while (!platform_semaphore_try_wait(sem))
+    {
+        atomic_add_u32(&sem->waiters, 1, ATOMIC_SEQ_CST);
+        // sleeps only while count is still 0
+        syscall(SYS_futex, &sem->count, FUTEX_WAIT_PRIVATE, 0, NULL, NULL,
+                0);
+        atomic_sub_u32(&sem->waiters, 1, ATOMIC_SEQ_CST);
+    }
+}
+
+#    if PLATFORM_X11
 keys translate_keycode(u32 keycode)
 {
     switch (keycode)
@@ -456,4 +1420,6 @@ keys translate_keycode(u32 keycode)
     }
 }
 
+#    endif // PLATFORM_X11
+
 #endif
@@ -5,6 +5,7 @@ b8 game_set(game_entry_t *out)
     out->config.name = "2AM Engine Testbed";
     out->config.width = 800;
     out->config.height = 600;
+    out->config.target_fps = 60;
 
     out->init = game_init;
     out->update = game_update;
@@ -14,10 +14,10 @@ b8 game_update(game_entry_t *game_instance, f32 delta)
     return true;
 }
 
-b8 game_render(game_entry_t *game_instance, f32 delta)
+b8 game_render(game_entry_t *game_instance, f32 alpha)
 {
     (void)game_instance;
-    (void)delta;
+    (void)alpha;
     return true;
 }
 
@@ -11,7 +11,7 @@ b8 game_init(game_entry_t *game_instance);
 
 b8 game_update(game_entry_t *game_instance, f32 delta);
 
-b8 game_render(game_entry_t *game_instance, f32 delta);
+b8 game_render(game_entry_t *game_instance, f32 alpha);
 
 void game_resize(game_entry_t *game_instance, u32 width, u32 height);
 